@@ -15,12 +15,26 @@
 #include <stdio.h>
 #include <string.h>
 #include "jabcode.h"
+#include "detector.h"
+#include "parallel.h"
+//JAB_GENERIC_KERNELS builds only the portable kernels, e.g. to compare them with the vector kernels
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(JAB_GENERIC_KERNELS)
+#include <immintrin.h>
+#define BINARIZER_X86_SIMD
+#endif
 
 #define BLOCK_SIZE_POWER	3
 #define BLOCK_SIZE 			(1 << BLOCK_SIZE_POWER)
 #define BLOCK_SIZE_MASK 	(BLOCK_SIZE - 1)
 #define MINIMUM_DIMENSION 	(BLOCK_SIZE * 5)
 #define CAP(val, min, max)	(val < min ? min : (val > max ? max : val))
+#define FILTER_SIZE			5
+#define FILTER_HALF_SIZE	((FILTER_SIZE - 1) / 2)
+#define BAND_BLOCK_ROWS		16	//the number of block rows per band in parallel binarization
+#define BAND_ROWS			(BAND_BLOCK_ROWS * BLOCK_SIZE)
+#define INTEGRAL_DEFAULT_RADIUS		20	//about the 5x5 block neighborhood of the block binarizer
+#define INTEGRAL_MAX_RADIUS			2047	//keeps the window sums below 2^32
+#define INTEGRAL_THRESHOLD_PERCENT	15	//a pixel is dark if it is this much darker than its local mean
 
 /**
  * @brief Check bimodal/trimodal distribution
@@ -203,245 +217,1308 @@ jab_bitmap* binarizerHard(jab_bitmap* bitmap, jab_int32 channel, jab_int32 thres
 }
 
 /**
- * @brief Do local binarization based on the black points
- * @param bitmap the input bitmap
- * @param channel the color channel
- * @param sub_width the number of blocks in x direction
- * @param sub_height the number of blocks in y direction
- * @param black_points the black points
- * @param binary the binarized bitmap
+ * @brief Read a pixel with the color enhancement for the binarization of the r, g and b channels
+ * Red and magenta pixels get blue raised to red, saturated green pixels get more green and less red.
+ * This is the integer form of the hue thresholds 30 and 270 for red and the green ratio checks,
+ * so the pixels are enhanced while they are read instead of in a separate pass.
+ * @param pixel the pixel
+ * @param rgb the enhanced r, g and b values
 */
-void getBinaryBitmap(jab_bitmap* bitmap, jab_int32 channel, jab_int32 sub_width, jab_int32 sub_height, jab_byte* black_points, jab_bitmap* binary)
+static inline void enhancePixel(const jab_byte* pixel, jab_int32 rgb[3])
 {
-    jab_int32 bytes_per_pixel = bitmap->bits_per_pixel / 8;
-    jab_int32 bytes_per_row = bitmap->width * bytes_per_pixel;
+    jab_int32 r = pixel[0], g = pixel[1], b = pixel[2];
+    //red is the maximum and the hue is below 30 or above 270
+    jab_int32 magenta = r > MAX(b - 1, 2 * g - b);
+    //green is the maximum and clearly above red and blue
+    jab_int32 green = (g - r) > (r >> 1) && (g - b) > (b >> 1);
+    rgb[0] = green ? (r * 171) >> 9 : r;	//r / 3
+    rgb[1] = green ? MIN(g + (g >> 1), 255) : g;
+    rgb[2] = magenta ? r : b;
+}
 
-    for (jab_int32 y=0; y<sub_height; y++)
+/**
+ * @brief Enhance the colors of pixels for the binarization of the r, g and b channels
+ * @param src the source pixels
+ * @param dst the enhanced pixels
+ * @param pixel_number the number of pixels
+ * @param bytes_per_pixel the number of bytes per pixel
+*/
+static void enhancePixels(const jab_byte* src, jab_byte* dst, jab_int32 pixel_number, jab_int32 bytes_per_pixel)
+{
+    for (jab_int32 i=0; i<pixel_number; i++, src += bytes_per_pixel, dst += bytes_per_pixel)
     {
-        jab_int32 yoffset = y << BLOCK_SIZE_POWER;
-        jab_int32 max_yoffset = bitmap->height - BLOCK_SIZE;
-        if (yoffset > max_yoffset)
-        {
-            yoffset = max_yoffset;
-        }
-        for (jab_int32 x=0; x<sub_width; x++)
+        jab_int32 rgb[3];
+        enhancePixel(src, rgb);
+        memcpy(dst, src, bytes_per_pixel);
+        for (jab_int32 c=0; c<3; c++)
+            dst[c] = (jab_byte)rgb[c];
+    }
+}
+
+/**
+ * @brief Calculate the sum, minimum and maximum of the r, g and b channels in a block
+ * @param pixel the top left pixel of the block
+ * @param bytes_per_row the number of bytes per bitmap row
+ * @param bytes_per_pixel the number of bytes per pixel
+ * @param sum the channel sums
+ * @param min the channel minimums
+ * @param max the channel maximums
+*/
+static void blockStatsGeneric(const jab_byte* pixel, jab_int32 bytes_per_row, jab_int32 bytes_per_pixel, jab_int32 sum[3], jab_int32 min[3], jab_int32 max[3])
+{
+    for (jab_int32 c=0; c<3; c++)
+    {
+        sum[c] = 0;
+        min[c] = 0xFF;
+        max[c] = 0;
+    }
+    for (jab_int32 yy=0; yy<BLOCK_SIZE; yy++, pixel += bytes_per_row)
+    {
+        const jab_byte* p = pixel;
+        for (jab_int32 xx=0; xx<BLOCK_SIZE; xx++, p += bytes_per_pixel)
         {
-            jab_int32 xoffset = x << BLOCK_SIZE_POWER;
-            jab_int32 max_xoffset = bitmap->width - BLOCK_SIZE;
-            if (xoffset > max_xoffset)
+            jab_int32 rgb[3];
+            enhancePixel(p, rgb);
+            for (jab_int32 c=0; c<3; c++)
             {
-                xoffset = max_xoffset;
+                sum[c] += rgb[c];
+                if (rgb[c] < min[c]) min[c] = rgb[c];
+                if (rgb[c] > max[c]) max[c] = rgb[c];
             }
-            jab_int32 left = CAP(x, 2, sub_width - 3);
-            jab_int32 top = CAP(y, 2, sub_height - 3);
-            jab_int32 sum = 0;
-            for (jab_int32 z = -2; z <= 2; z++)
-            {
-                jab_byte* black_row = &black_points[(top + z) * sub_width];
-                sum += black_row[left - 2] + black_row[left - 1] + black_row[left] + black_row[left + 1] + black_row[left + 2];
-            }
-            jab_int32 average = sum / 25;
+        }
+    }
+}
 
-            //threshold block
-            for (jab_int32 yy = 0; yy < BLOCK_SIZE; yy++)
-            {
-                for (jab_int32 xx = 0; xx < BLOCK_SIZE; xx++)
-                {
-                    jab_int32 offset = (yoffset + yy) * bytes_per_row + (xoffset + xx) * bytes_per_pixel;
-                    if (bitmap->pixel[offset + channel] > average)
-                    {
-                        binary->pixel[(yoffset + yy) * binary->width + (xoffset + xx)] = 255;
-                    }
-                }
-            }
+/**
+ * @brief Mark the pixels of a block brighter than the thresholds in the r, g and b binary bitmaps
+ * @param pixel the top left pixel of the block
+ * @param bytes_per_row the number of bytes per bitmap row
+ * @param bytes_per_pixel the number of bytes per pixel
+ * @param average the channel thresholds
+ * @param dst the top left pixels of the block in the three binary bitmaps
+ * @param width the binary bitmap width
+*/
+static void thresholdBlockGeneric(const jab_byte* pixel, jab_int32 bytes_per_row, jab_int32 bytes_per_pixel, const jab_int32 average[3], jab_byte* dst[3], jab_int32 width)
+{
+    for (jab_int32 yy=0; yy<BLOCK_SIZE; yy++, pixel += bytes_per_row)
+    {
+        const jab_byte* p = pixel;
+        jab_int32 index = yy * width;
+        for (jab_int32 xx=0; xx<BLOCK_SIZE; xx++, p += bytes_per_pixel)
+        {
+            jab_int32 rgb[3];
+            enhancePixel(p, rgb);
+            if (rgb[0] > average[0]) dst[0][index + xx] = 255;
+            if (rgb[1] > average[1]) dst[1][index + xx] = 255;
+            if (rgb[2] > average[2]) dst[2][index + xx] = 255;
         }
     }
 }
 
+#ifdef BINARIZER_X86_SIMD
+//the vector kernels require 4 bytes per pixel, so that a block row of 8 pixels is 32 bytes
+
 /**
- * @brief Calculate the black point of each block
- * @param bitmap the input bitmap
- * @param channel the color channel
- * @param sub_width the number of blocks in x direction
- * @param sub_height the number of blocks in y direction
- * @param black_points the black points
+ * @brief Enhance the colors of 4 pixels as enhancePixel does
+ * @param v the pixels
+ * @return the enhanced pixels
 */
-void calculateBlackPoints(jab_bitmap* bitmap, jab_int32 channel, jab_int32 sub_width, jab_int32 sub_height, jab_byte* black_points)
+__attribute__((target("sse2")))
+static inline __m128i enhancePixelsSSE2(__m128i v)
 {
-    jab_int32 min_dynamic_range = 24;
+    __m128i mask = _mm_set1_epi32(0xFF);
+    __m128i r = _mm_and_si128(v, mask);
+    __m128i g = _mm_and_si128(_mm_srli_epi32(v, 8), mask);
+    __m128i b = _mm_and_si128(_mm_srli_epi32(v, 16), mask);
+    __m128i magenta = _mm_and_si128(_mm_cmpgt_epi32(r, _mm_sub_epi32(b, _mm_set1_epi32(1))),
+                                    _mm_cmpgt_epi32(r, _mm_sub_epi32(_mm_add_epi32(g, g), b)));
+    __m128i green = _mm_and_si128(_mm_cmpgt_epi32(_mm_sub_epi32(g, r), _mm_srli_epi32(r, 1)),
+                                  _mm_cmpgt_epi32(_mm_sub_epi32(g, b), _mm_srli_epi32(b, 1)));
+    //the upper halves of the 32-bit lanes are zero, so 16-bit multiplication and minimum are exact
+    __m128i green_r = _mm_srli_epi32(_mm_mullo_epi16(r, _mm_set1_epi32(171)), 9);
+    __m128i green_g = _mm_min_epi16(_mm_add_epi32(g, _mm_srli_epi32(g, 1)), mask);
+    b = _mm_or_si128(_mm_and_si128(magenta, r), _mm_andnot_si128(magenta, b));
+    r = _mm_or_si128(_mm_and_si128(green, green_r), _mm_andnot_si128(green, r));
+    g = _mm_or_si128(_mm_and_si128(green, green_g), _mm_andnot_si128(green, g));
+    __m128i alpha = _mm_andnot_si128(_mm_set1_epi32(0xFFFFFF), v);
+    return _mm_or_si128(_mm_or_si128(alpha, r), _mm_or_si128(_mm_slli_epi32(g, 8), _mm_slli_epi32(b, 16)));
+}
 
-    jab_int32 bytes_per_pixel = bitmap->bits_per_pixel / 8;
-    jab_int32 bytes_per_row = bitmap->width * bytes_per_pixel;
+/**
+ * @brief Enhance the colors of 8 pixels as enhancePixel does
+ * @param v the pixels
+ * @return the enhanced pixels
+*/
+__attribute__((target("avx2")))
+static inline __m256i enhancePixelsAVX2(__m256i v)
+{
+    __m256i mask = _mm256_set1_epi32(0xFF);
+    __m256i r = _mm256_and_si256(v, mask);
+    __m256i g = _mm256_and_si256(_mm256_srli_epi32(v, 8), mask);
+    __m256i b = _mm256_and_si256(_mm256_srli_epi32(v, 16), mask);
+    __m256i magenta = _mm256_cmpgt_epi32(r, _mm256_max_epi32(_mm256_sub_epi32(b, _mm256_set1_epi32(1)), _mm256_sub_epi32(_mm256_add_epi32(g, g), b)));
+    __m256i green = _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_sub_epi32(g, r), _mm256_srli_epi32(r, 1)),
+                                     _mm256_cmpgt_epi32(_mm256_sub_epi32(g, b), _mm256_srli_epi32(b, 1)));
+    __m256i green_r = _mm256_srli_epi32(_mm256_mullo_epi16(r, _mm256_set1_epi32(171)), 9);
+    __m256i green_g = _mm256_min_epi32(_mm256_add_epi32(g, _mm256_srli_epi32(g, 1)), mask);
+    b = _mm256_blendv_epi8(b, r, magenta);
+    r = _mm256_blendv_epi8(r, green_r, green);
+    g = _mm256_blendv_epi8(g, green_g, green);
+    __m256i alpha = _mm256_andnot_si256(_mm256_set1_epi32(0xFFFFFF), v);
+    return _mm256_or_si256(_mm256_or_si256(alpha, r), _mm256_or_si256(_mm256_slli_epi32(g, 8), _mm256_slli_epi32(b, 16)));
+}
 
-    for(jab_int32 y=0; y<sub_height; y++)
+/**
+ * @brief Reduce the per pixel statistics of 4 pixels to the r, g and b channel statistics
+ * @param sum16 the 16-bit sums of 2 pixels
+ * @param vmin the minimums of 4 pixels
+ * @param vmax the maximums of 4 pixels
+ * @param sum the channel sums
+ * @param min the channel minimums
+ * @param max the channel maximums
+*/
+__attribute__((target("sse2")))
+static void reduceBlockStatsSSE2(__m128i sum16, __m128i vmin, __m128i vmax, jab_int32 sum[3], jab_int32 min[3], jab_int32 max[3])
+{
+    sum16 = _mm_add_epi16(sum16, _mm_srli_si128(sum16, 8));
+    vmin = _mm_min_epu8(vmin, _mm_srli_si128(vmin, 8));
+    vmin = _mm_min_epu8(vmin, _mm_srli_si128(vmin, 4));
+    vmax = _mm_max_epu8(vmax, _mm_srli_si128(vmax, 8));
+    vmax = _mm_max_epu8(vmax, _mm_srli_si128(vmax, 4));
+    jab_uint16 s[8];
+    jab_byte lo[16], hi[16];
+    _mm_storeu_si128((__m128i*)s, sum16);
+    _mm_storeu_si128((__m128i*)lo, vmin);
+    _mm_storeu_si128((__m128i*)hi, vmax);
+    for (jab_int32 c=0; c<3; c++)
     {
-        jab_int32 yoffset = y << BLOCK_SIZE_POWER;
-        jab_int32 max_yoffset = bitmap->height - BLOCK_SIZE;
-        if (yoffset > max_yoffset)
-        {
-            yoffset = max_yoffset;
-        }
-        for (jab_int32 x=0; x<sub_width; x++)
-        {
-            jab_int32 xoffset = x << BLOCK_SIZE_POWER;
-            jab_int32 max_xoffset = bitmap->width - BLOCK_SIZE;
-            if (xoffset > max_xoffset)
-            {
-                xoffset = max_xoffset;
-            }
-            jab_int32 sum = 0;
-            jab_int32 min = 0xFF;
-            jab_int32 max = 0;
-            for (jab_int32 yy=0; yy<BLOCK_SIZE; yy++)
-            {
-                for (jab_int32 xx=0; xx<BLOCK_SIZE; xx++)
-                {
-                    jab_int32 offset = (yoffset + yy) * bytes_per_row + (xoffset + xx) * bytes_per_pixel;
-                    jab_byte pixel = bitmap->pixel[offset + channel];
-                    sum += pixel;
-                    //check contrast
-                    if (pixel < min)
-                    {
-                        min = pixel;
-                    }
-                    if (pixel > max)
-                    {
-                        max = pixel;
-                    }
-                }
-                //bypass contrast check once the dynamic range is met
-                if (max-min > min_dynamic_range)
-                {
-                    //finish the rest of the rows quickly
-                    for (yy++; yy < BLOCK_SIZE; yy++)
-                    {
-                        for (jab_int32 xx = 0; xx < BLOCK_SIZE; xx++)
-                        {
-                            jab_int32 offset = (yoffset + yy) * bytes_per_row + (xoffset + xx) * bytes_per_pixel;
-                            sum += bitmap->pixel[offset + channel];
-                        }
-                    }
-                }
-            }
+        sum[c] = s[c];
+        min[c] = lo[c];
+        max[c] = hi[c];
+    }
+}
 
-            jab_int32 average = sum >> (BLOCK_SIZE_POWER * 2);
-            if (max-min <= min_dynamic_range)	//smooth block
-            {
-                average = min / 2;
-                if (y > 0 && x > 0)
-                {
-                    jab_int32 average_neighbor_blackpoint = (black_points[(y-1) * sub_width + x] +
-                                                            (2 * black_points[y * sub_width + x-1]) +
-                                                            black_points[(y-1) * sub_width + x-1]) / 4;
-                    if (min < average_neighbor_blackpoint)
-                    {
-                        average = average_neighbor_blackpoint;
-                    }
-                }
-            }
-            black_points[y*sub_width + x] = (jab_byte)average;
-        }
+__attribute__((target("sse2")))
+static void blockStatsSSE2(const jab_byte* pixel, jab_int32 bytes_per_row, jab_int32 bytes_per_pixel, jab_int32 sum[3], jab_int32 min[3], jab_int32 max[3])
+{
+    (void)bytes_per_pixel;
+    __m128i zero = _mm_setzero_si128();
+    __m128i sum16 = zero;
+    __m128i vmin = _mm_set1_epi8((char)0xFF);
+    __m128i vmax = zero;
+    for (jab_int32 yy=0; yy<BLOCK_SIZE; yy++, pixel += bytes_per_row)
+    {
+        __m128i a = enhancePixelsSSE2(_mm_loadu_si128((const __m128i*)pixel));
+        __m128i b = enhancePixelsSSE2(_mm_loadu_si128((const __m128i*)(pixel + 16)));
+        vmin = _mm_min_epu8(vmin, _mm_min_epu8(a, b));
+        vmax = _mm_max_epu8(vmax, _mm_max_epu8(a, b));
+        //64 values of at most 255 per channel fit into 16 bits
+        sum16 = _mm_add_epi16(sum16, _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpackhi_epi8(a, zero)));
+        sum16 = _mm_add_epi16(sum16, _mm_add_epi16(_mm_unpacklo_epi8(b, zero), _mm_unpackhi_epi8(b, zero)));
+    }
+    reduceBlockStatsSSE2(sum16, vmin, vmax, sum, min, max);
+}
+
+__attribute__((target("avx2")))
+static void blockStatsAVX2(const jab_byte* pixel, jab_int32 bytes_per_row, jab_int32 bytes_per_pixel, jab_int32 sum[3], jab_int32 min[3], jab_int32 max[3])
+{
+    (void)bytes_per_pixel;
+    __m256i zero = _mm256_setzero_si256();
+    __m256i sum16 = zero;
+    __m256i vmin = _mm256_set1_epi8((char)0xFF);
+    __m256i vmax = zero;
+    for (jab_int32 yy=0; yy<BLOCK_SIZE; yy++, pixel += bytes_per_row)
+    {
+        __m256i a = enhancePixelsAVX2(_mm256_loadu_si256((const __m256i*)pixel));
+        vmin = _mm256_min_epu8(vmin, a);
+        vmax = _mm256_max_epu8(vmax, a);
+        sum16 = _mm256_add_epi16(sum16, _mm256_add_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpackhi_epi8(a, zero)));
     }
+    __m128i s = _mm_add_epi16(_mm256_castsi256_si128(sum16), _mm256_extracti128_si256(sum16, 1));
+    __m128i lo = _mm_min_epu8(_mm256_castsi256_si128(vmin), _mm256_extracti128_si256(vmin, 1));
+    __m128i hi = _mm_max_epu8(_mm256_castsi256_si128(vmax), _mm256_extracti128_si256(vmax, 1));
+    _mm256_zeroupper();
+    reduceBlockStatsSSE2(s, lo, hi, sum, min, max);
 }
 
+__attribute__((target("sse2")))
+static void thresholdBlockSSE2(const jab_byte* pixel, jab_int32 bytes_per_row, jab_int32 bytes_per_pixel, const jab_int32 average[3], jab_byte* dst[3], jab_int32 width)
+{
+    (void)bytes_per_pixel;
+    //unsigned comparison through the signed one with flipped sign bits, the alpha channel is never brighter than 255
+    __m128i bias = _mm_set1_epi8((char)0x80);
+    __m128i threshold = _mm_xor_si128(_mm_set1_epi32((jab_int32)(average[0] | (average[1] << 8) | (average[2] << 16) | 0xFF000000u)), bias);
+    for (jab_int32 yy=0; yy<BLOCK_SIZE; yy++, pixel += bytes_per_row)
+    {
+        __m128i a = _mm_cmpgt_epi8(_mm_xor_si128(enhancePixelsSSE2(_mm_loadu_si128((const __m128i*)pixel)), bias), threshold);
+        __m128i b = _mm_cmpgt_epi8(_mm_xor_si128(enhancePixelsSSE2(_mm_loadu_si128((const __m128i*)(pixel + 16))), bias), threshold);
+        //deinterleave the masks of the 8 pixels into r, g, b and alpha runs
+        __m128i t0 = _mm_unpacklo_epi8(a, b);
+        __m128i t1 = _mm_unpackhi_epi8(a, b);
+        __m128i u0 = _mm_unpacklo_epi8(t0, t1);
+        __m128i u1 = _mm_unpackhi_epi8(t0, t1);
+        __m128i rg = _mm_unpacklo_epi8(u0, u1);
+        __m128i ba = _mm_unpackhi_epi8(u0, u1);
+        //the binary pixels are either 0 or 255, so marking them is a bitwise or
+        jab_int32 index = yy * width;
+        _mm_storel_epi64((__m128i*)(dst[0] + index), _mm_or_si128(_mm_loadl_epi64((const __m128i*)(dst[0] + index)), rg));
+        _mm_storel_epi64((__m128i*)(dst[1] + index), _mm_or_si128(_mm_loadl_epi64((const __m128i*)(dst[1] + index)), _mm_srli_si128(rg, 8)));
+        _mm_storel_epi64((__m128i*)(dst[2] + index), _mm_or_si128(_mm_loadl_epi64((const __m128i*)(dst[2] + index)), ba));
+    }
+}
+
+__attribute__((target("avx2")))
+static void thresholdBlockAVX2(const jab_byte* pixel, jab_int32 bytes_per_row, jab_int32 bytes_per_pixel, const jab_int32 average[3], jab_byte* dst[3], jab_int32 width)
+{
+    (void)bytes_per_pixel;
+    __m256i bias = _mm256_set1_epi8((char)0x80);
+    __m256i threshold = _mm256_xor_si256(_mm256_set1_epi32((jab_int32)(average[0] | (average[1] << 8) | (average[2] << 16) | 0xFF000000u)), bias);
+    //gather the channels of each 128-bit lane, then the lanes into r, g, b and alpha runs of 8 pixels
+    __m256i gather = _mm256_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+                                      0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+    __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    for (jab_int32 yy=0; yy<BLOCK_SIZE; yy++, pixel += bytes_per_row)
+    {
+        __m256i mask = _mm256_cmpgt_epi8(_mm256_xor_si256(enhancePixelsAVX2(_mm256_loadu_si256((const __m256i*)pixel)), bias), threshold);
+        mask = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(mask, gather), order);
+        __m128i rg = _mm256_castsi256_si128(mask);
+        __m128i ba = _mm256_extracti128_si256(mask, 1);
+        jab_int32 index = yy * width;
+        _mm_storel_epi64((__m128i*)(dst[0] + index), _mm_or_si128(_mm_loadl_epi64((const __m128i*)(dst[0] + index)), rg));
+        _mm_storel_epi64((__m128i*)(dst[1] + index), _mm_or_si128(_mm_loadl_epi64((const __m128i*)(dst[1] + index)), _mm_srli_si128(rg, 8)));
+        _mm_storel_epi64((__m128i*)(dst[2] + index), _mm_or_si128(_mm_loadl_epi64((const __m128i*)(dst[2] + index)), ba));
+    }
+    _mm256_zeroupper();
+}
+#endif
+
+static void (*block_stats_kernel)(const jab_byte*, jab_int32, jab_int32, jab_int32*, jab_int32*, jab_int32*) = NULL;
+static void (*threshold_block_kernel)(const jab_byte*, jab_int32, jab_int32, const jab_int32*, jab_byte**, jab_int32) = NULL;
+
 /**
- * @brief Filter out noises in binary bitmap
+ * @brief Select the best block kernels for the CPU
+*/
+static void selectBlockKernels(void)
+{
+    if(__atomic_load_n(&threshold_block_kernel, __ATOMIC_ACQUIRE) != NULL)
+        return;
+    void (*stats)(const jab_byte*, jab_int32, jab_int32, jab_int32*, jab_int32*, jab_int32*) = blockStatsGeneric;
+    void (*threshold)(const jab_byte*, jab_int32, jab_int32, const jab_int32*, jab_byte**, jab_int32) = thresholdBlockGeneric;
+#ifdef BINARIZER_X86_SIMD
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+    {
+        stats = blockStatsAVX2;
+        threshold = thresholdBlockAVX2;
+    }
+    else if(__builtin_cpu_supports("sse2"))
+    {
+        stats = blockStatsSSE2;
+        threshold = thresholdBlockSSE2;
+    }
+#endif
+    __atomic_store_n(&block_stats_kernel, stats, __ATOMIC_RELAXED);
+    __atomic_store_n(&threshold_block_kernel, threshold, __ATOMIC_RELEASE);
+}
+
+#define BYTES_ONE	0x0101010101010101ULL
+
+/**
+ * @brief Load 8 bytes as a word
+ * @param p the bytes
+ * @return the word
+*/
+static inline jab_uint64 loadBytes(const jab_byte* p)
+{
+	jab_uint64 word;
+	memcpy(&word, p, sizeof(jab_uint64));
+	return word;
+}
+
+/**
+ * @brief Map each nonzero byte of a word to 1 and each zero byte to 0
+ * @param word the word
+ * @return the mapped word
+*/
+static inline jab_uint64 nonzeroBytes(jab_uint64 word)
+{
+	return (((word & (0x7F * BYTES_ONE)) + 0x7F * BYTES_ONE) | word) >> 7 & BYTES_ONE;
+}
+
+/**
+ * @brief Map each byte of a word holding a window count to 255 if it is larger than the threshold and to 0 otherwise
+ * @param count the window counts, each smaller than 0x80 - threshold
+ * @param threshold the threshold
+ * @return the binary pixels
+*/
+static inline jab_uint64 majorityBytes(jab_uint64 count, jab_int32 threshold)
+{
+	return ((count + (0x7F - threshold) * BYTES_ONE) >> 7 & BYTES_ONE) * 0xFF;
+}
+
+/**
+ * @brief Filter out noises in rows of a binary bitmap in horizontal direction
  * @param binary the binarized bitmap
+ * @param begin the first row
+ * @param end the row after the last one
+ * @param line a buffer of one row
 */
-void filterBinary(jab_bitmap* binary)
+static void filterRowsHorizontal(jab_bitmap* binary, jab_int32 begin, jab_int32 end, jab_byte* line)
 {
 	jab_int32 width = binary->width;
-	jab_int32 height= binary->height;
+	jab_int32 half_size = FILTER_HALF_SIZE;
+	begin = MAX(begin, half_size);
+	end = MIN(end, binary->height - half_size);
+	for(jab_int32 i=begin; i<end; i++)
+	{
+		jab_byte* row = &binary->pixel[i*width];
+		jab_int32 j = 0;
+		for(; j+8<=width; j+=8)
+		{
+			jab_uint64 ones = nonzeroBytes(loadBytes(row + j));
+			memcpy(line + j, &ones, sizeof(jab_uint64));
+		}
+		for(; j<width; j++)
+			line[j] = row[j] > 0;
+		j = half_size;
+		for(; j+8+half_size<=width; j+=8)
+		{
+			jab_uint64 sum = loadBytes(line + j);
+			for(jab_int32 k=1; k<=half_size; k++)
+				sum += loadBytes(line + j - k) + loadBytes(line + j + k);
+			jab_uint64 pixels = majorityBytes(sum, half_size);
+			memcpy(row + j, &pixels, sizeof(jab_uint64));
+		}
+		for(; j<width-half_size; j++)
+		{
+			jab_int32 sum = line[j];
+			for(jab_int32 k=1; k<=half_size; k++)
+				sum += line[j - k] + line[j + k];
+			row[j] = sum > half_size ? 255 : 0;
+		}
+	}
+}
+
+/**
+ * @brief Load a 64-bit word of a bit-packed binary row, with pixel x in bit x%64
+ * @param row the row
+ * @param index the word index
+ * @return the word
+*/
+static inline jab_uint64 loadBinaryWord(const jab_byte* row, jab_int32 index)
+{
+	jab_uint64 word = loadBytes(row + index * 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	word = __builtin_bswap64(word);
+#endif
+	return word;
+}
+
+/**
+ * @brief Find the end of the run of pixels with the same color in a bit-packed binary row
+ * @param row the row
+ * @param x the position in the run
+ * @param end the end of the search range
+ * @return the first position after x with a different color | end if there is none before end
+*/
+jab_int32 findRunEnd(const jab_byte* row, jab_int32 x, jab_int32 end)
+{
+	if(x >= end)
+		return end;
+	jab_uint64 color = getRowPixel(row, x) ? ~0ULL : 0;
+	jab_int32 index = x >> 6;
+	jab_uint64 change = (loadBinaryWord(row, index) ^ color) & (~0ULL << (x & 63));
+	while(change == 0)
+	{
+		index++;
+		if(index * 64 >= end)
+			return end;
+		change = loadBinaryWord(row, index) ^ color;
+	}
+	jab_int32 pos = index * 64 + __builtin_ctzll(change);
+	return pos < end ? pos : end;
+}
+
+/**
+ * @brief Find the start of the run of pixels with the same color in a bit-packed binary row
+ * @param row the row
+ * @param x the position in the run
+ * @param begin the begin of the search range
+ * @return the first position of the run not before begin
+*/
+jab_int32 findRunStart(const jab_byte* row, jab_int32 x, jab_int32 begin)
+{
+	if(x <= begin)
+		return begin;
+	jab_uint64 color = getRowPixel(row, x) ? ~0ULL : 0;
+	jab_int32 index = x >> 6;
+	jab_uint64 change = (loadBinaryWord(row, index) ^ color) & (~0ULL >> (63 - (x & 63)));
+	while(change == 0)
+	{
+		if(index * 64 <= begin)
+			return begin;
+		index--;
+		change = loadBinaryWord(row, index) ^ color;
+	}
+	jab_int32 pos = index * 64 + 64 - __builtin_clzll(change);
+	return pos > begin ? pos : begin;
+}
+
+/**
+ * @brief Count the bright pixels in a range of a bit-packed binary row
+ * @param row the row
+ * @param begin the first position
+ * @param end the position after the last one
+ * @return the number of bright pixels
+*/
+jab_int32 countBinaryPixels(const jab_byte* row, jab_int32 begin, jab_int32 end)
+{
+	jab_int32 count = 0;
+	while(begin < end)
+	{
+		jab_int32 index = begin >> 6;
+		jab_int32 bits = MIN(64 - (begin & 63), end - begin);
+		jab_uint64 word = loadBinaryWord(row, index) >> (begin & 63);
+		if(bits < 64)
+			word &= (1ULL << bits) - 1;
+		count += __builtin_popcountll(word);
+		begin += bits;
+	}
+	return count;
+}
+
+/**
+ * @brief Convert a bit-packed binary row into runs of pixels with the same color
+ * @param row the row
+ * @param width the row width
+ * @param runs the runs, with space for width+1 start positions
+ * @return the number of runs
+*/
+jab_int32 getRowRuns(const jab_byte* row, jab_int32 width, jab_row_runs* runs)
+{
+	jab_int32 count = 0;
+	runs->start[count++] = 0;
+	//a run starts where a pixel differs from its left neighbor, the first pixel is its own left neighbor
+	jab_uint64 carry = row[0] & 1;
+	for(jab_int32 index=0; index*64<width; index++)
+	{
+		jab_uint64 word = loadBinaryWord(row, index);
+		jab_uint64 change = word ^ ((word << 1) | carry);
+		carry = word >> 63;
+		if(width - index*64 < 64)
+			change &= (1ULL << (width - index*64)) - 1;
+		while(change)
+		{
+			runs->start[count++] = index * 64 + __builtin_ctzll(change);
+			change &= change - 1;
+		}
+	}
+	runs->start[count] = width;
+	runs->count = count;
+	runs->cursor = 0;
+	return count;
+}
 
-	jab_int32 filter_size = 5;
-	jab_int32 half_size = (filter_size - 1)/2;
+/**
+ * @brief Find the run containing a position
+ * The lookups along a row mostly move to the right, so the search walks forward from the run of the
+ * last lookup and only falls back to a binary search for a position on its left.
+ * @param runs the runs of a row
+ * @param x the position
+ * @return the run index
+*/
+jab_int32 findRunIndex(jab_row_runs* runs, jab_int32 x)
+{
+	jab_int32 low = runs->cursor;
+	if(runs->start[low] <= x)
+	{
+		while(low < runs->count - 1 && runs->start[low+1] <= x)
+			low++;
+	}
+	else
+	{
+		jab_int32 high = low - 1;
+		low = 0;
+		while(low < high)
+		{
+			jab_int32 middle = (low + high + 1) / 2;
+			if(runs->start[middle] <= x)
+				low = middle;
+			else
+				high = middle - 1;
+		}
+	}
+	runs->cursor = low;
+	return low;
+}
 
-	jab_bitmap* tmp = (jab_bitmap*)malloc(sizeof(jab_bitmap) + width*height*sizeof(jab_byte));
-	if(tmp == NULL)
+/**
+ * @brief Pack a binary row with one byte per pixel into one bit per pixel
+ * @param src the row with one byte per pixel
+ * @param dst the bit-packed row, which may overlap the first src bytes
+ * @param width the row width
+*/
+static void packRow(const jab_byte* src, jab_byte* dst, jab_int32 width)
+{
+	jab_int32 row_bytes = BINARY_ROW_BYTES(width);
+	jab_int32 j = 0;
+	for(; j+8<=width; j+=8)
+	{
+		//gather the lowest bits of the 8 bytes into the top byte
+		jab_uint64 ones = nonzeroBytes(loadBytes(src + j));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		ones = __builtin_bswap64(ones);
+#endif
+		dst[j >> 3] = (jab_byte)((ones * 0x0102040810204080ULL) >> 56);
+	}
+	if(j < width)
 	{
-		reportError("Memory allocation for temporary binary bitmap failed");
+		jab_byte bits = 0;
+		for(jab_int32 k=0; j+k<width; k++)
+			bits |= (src[j + k] > 0) << k;
+		dst[j >> 3] = bits;
+		j += 8;
+	}
+	memset(&dst[j >> 3], 0, row_bytes - (j >> 3));
+}
+
+/**
+ * @brief Pack a binary bitmap with one byte per pixel into one bit per pixel
+ * @param binary the binary bitmap, which is packed in place and resized
+ * @return the packed binary bitmap | NULL if failed
+*/
+jab_bitmap* packBinary(jab_bitmap* binary)
+{
+	jab_int32 width = binary->width;
+	jab_int32 row_bytes = BINARY_ROW_BYTES(width);
+	//pack in place if the packed rows never overtake the unpacked ones, which holds unless the bitmap is very narrow
+	jab_bitmap* packed = binary;
+	if(row_bytes > width)
+	{
+		packed = (jab_bitmap*)malloc(sizeof(jab_bitmap) + binary->height*row_bytes*sizeof(jab_byte));
+		if(packed == NULL)
+		{
+			reportError("Memory allocation for packed binary bitmap failed");
+			free(binary);
+			return NULL;
+		}
+		packed->width = width;
+		packed->height= binary->height;
+		packed->channel_count = 1;
+	}
+	for(jab_int32 i=0; i<binary->height; i++)
+	{
+		packRow(&binary->pixel[i*width], &packed->pixel[i*row_bytes], width);
+	}
+	packed->bits_per_channel = 1;
+	packed->bits_per_pixel = 1;
+	if(packed != binary)
+	{
+		free(binary);
+		return packed;
+	}
+	packed = (jab_bitmap*)realloc(binary, sizeof(jab_bitmap) + binary->height*row_bytes*sizeof(jab_byte));
+	if(packed == NULL)
+	{
+		reportError("Memory reallocation for packed binary bitmap failed");
+		free(binary);
+	}
+	return packed;
+}
+
+/**
+ * @brief Unpack a bit-packed binary bitmap into one byte per pixel
+ * @param binary the bit-packed binary bitmap
+ * @return the unpacked binary bitmap | NULL if failed
+*/
+jab_bitmap* unpackBinary(jab_bitmap* binary)
+{
+	jab_bitmap* unpacked = (jab_bitmap*)malloc(sizeof(jab_bitmap) + binary->width*binary->height*sizeof(jab_byte));
+	if(unpacked == NULL)
+	{
+		reportError("Memory allocation for unpacked binary bitmap failed");
+		return NULL;
+	}
+	unpacked->width = binary->width;
+	unpacked->height= binary->height;
+	unpacked->bits_per_channel = 8;
+	unpacked->bits_per_pixel = 8;
+	unpacked->channel_count = 1;
+	for(jab_int32 i=0; i<binary->height; i++)
+	{
+		const jab_byte* row = getBinaryRow(binary, i);
+		for(jab_int32 j=0; j<binary->width; j++)
+			unpacked->pixel[i*binary->width + j] = getRowPixel(row, j) ? 255 : 0;
+	}
+	return unpacked;
+}
+
+/**
+ * @brief Keep the even bits of a word, packed into its lower half
+ * @param word the word
+ * @return the packed even bits
+*/
+static inline jab_uint64 compactEvenBits(jab_uint64 word)
+{
+	word &= 0x5555555555555555ULL;
+	word = (word | (word >> 1))  & 0x3333333333333333ULL;
+	word = (word | (word >> 2))  & 0x0f0f0f0f0f0f0f0fULL;
+	word = (word | (word >> 4))  & 0x00ff00ff00ff00ffULL;
+	word = (word | (word >> 8))  & 0x0000ffff0000ffffULL;
+	word = (word | (word >> 16)) & 0x00000000ffffffffULL;
+	return word;
+}
+
+/**
+ * @brief Downsample a bit-packed binary bitmap by two in both directions
+ * Each pixel of the result is the top-left pixel of its 2x2 block, so the color edges stay sharp.
+ * @param binary the bit-packed binary bitmap
+ * @return the downsampled bit-packed binary bitmap | NULL if failed
+*/
+jab_bitmap* downsampleBinary(jab_bitmap* binary)
+{
+	jab_int32 width = (binary->width + 1) / 2;
+	jab_int32 height = (binary->height + 1) / 2;
+	jab_int32 src_words = BINARY_ROW_BYTES(binary->width) / 8;
+	jab_int32 row_bytes = BINARY_ROW_BYTES(width);
+	jab_bitmap* half = (jab_bitmap*)malloc(sizeof(jab_bitmap) + height*row_bytes*sizeof(jab_byte));
+	if(half == NULL)
+	{
+		reportError("Memory allocation for downsampled binary bitmap failed");
+		return NULL;
+	}
+	half->width = width;
+	half->height= height;
+	half->bits_per_channel = 1;
+	half->bits_per_pixel = 1;
+	half->channel_count = 1;
+	for(jab_int32 i=0; i<height; i++)
+	{
+		const jab_byte* src = getBinaryRow(binary, 2*i);
+		jab_byte* dst = &half->pixel[i*row_bytes];
+		for(jab_int32 k=0; k<row_bytes/8; k++)
+		{
+			//two source words give one destination word
+			jab_uint64 word = compactEvenBits(loadBinaryWord(src, 2*k));
+			if(2*k + 1 < src_words)
+				word |= compactEvenBits(loadBinaryWord(src, 2*k + 1)) << 32;
+			for(jab_int32 b=0; b<8; b++)
+				dst[k*8 + b] = (jab_byte)(word >> (8*b));
+		}
+	}
+	return half;
+}
+
+/**
+ * @brief The shared state of the parallel r, g, b binarization
+*/
+typedef struct {
+	jab_bitmap*		bitmap;				///< the input bitmap
+	jab_int32		sub_width;			///< the number of blocks in x direction
+	jab_int32		sub_height;			///< the number of blocks in y direction
+	jab_int32		block_bands;		///< the number of bands of block rows
+	jab_int32		row_bands;			///< the number of bands of pixel rows per channel
+	jab_byte*		black_points[3];	///< the black points, or the block minimums of smooth blocks until they are resolved
+	jab_byte*		smooth[3];			///< 1 for smooth blocks, whose black points depend on the neighbors
+	jab_bitmap*		binary[3];			///< the binarized channels with one byte per pixel
+	jab_bitmap*		packed[3];			///< the filtered and bit-packed channels
+	jab_int32		radius;				///< the radius of the local mean window in integral binarization
+	jab_int32		integral_rows;		///< the number of pixel rows per band in integral binarization
+	jab_uint32*		window_sums;		///< the per-thread column and row sums of integral binarization
+	jab_uint64		deadline;			///< the time in microseconds after which the binarization is aborted, 0 for no limit
+	jab_boolean		expired;			///< set once the deadline has passed, the remaining bands are skipped
+}jab_binarizer_bands;
+
+/**
+ * @brief Check if the time budget of a binarization is exceeded
+ * @param bands the binarization state
+ * @return JAB_SUCCESS if exceeded | JAB_FAILURE
+*/
+static jab_boolean isBinarizerExpired(jab_binarizer_bands* bands)
+{
+	if(__atomic_load_n(&bands->expired, __ATOMIC_RELAXED))
+		return JAB_SUCCESS;
+	if(!isDeadlinePassed(bands->deadline))
+		return JAB_FAILURE;
+	__atomic_store_n(&bands->expired, 1, __ATOMIC_RELAXED);
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Get the block rows of a band, bands never share pixel rows even with the clamped last block rows
+ * @param bands the binarization state
+ * @param index the band index
+ * @param begin the first block row
+ * @param end the block row after the last one
+*/
+static void getBlockBand(jab_binarizer_bands* bands, jab_int32 index, jab_int32* begin, jab_int32* end)
+{
+	*begin = index * BAND_BLOCK_ROWS;
+	*end = index == bands->block_bands - 1 ? bands->sub_height : *begin + BAND_BLOCK_ROWS;
+}
+
+/**
+ * @brief Calculate the black points of non-smooth blocks in a band of the r, g and b channels
+ * @param context the binarization state
+ * @param index the band index
+ * @param thread_index the index of the executing thread
+*/
+static void calculateBlackPointsBand(void* context, jab_int32 index, jab_int32 thread_index)
+{
+	(void)thread_index;
+	jab_binarizer_bands* bands = (jab_binarizer_bands*)context;
+	if(isBinarizerExpired(bands))
 		return;
+	jab_bitmap* bitmap = bands->bitmap;
+	jab_int32 sub_width = bands->sub_width;
+	jab_int32 min_dynamic_range = 24;
+
+	jab_int32 bytes_per_pixel = bitmap->bits_per_pixel / 8;
+	jab_int32 bytes_per_row = bitmap->width * bytes_per_pixel;
+
+	//the vector kernels need 4 bytes per pixel
+	void (*stats)(const jab_byte*, jab_int32, jab_int32, jab_int32*, jab_int32*, jab_int32*) = blockStatsGeneric;
+	if (bytes_per_pixel == 4)
+		stats = __atomic_load_n(&block_stats_kernel, __ATOMIC_RELAXED);
+
+	jab_int32 begin, end;
+	getBlockBand(bands, index, &begin, &end);
+	for(jab_int32 y=begin; y<end; y++)
+	{
+		jab_int32 yoffset = MIN(y << BLOCK_SIZE_POWER, bitmap->height - BLOCK_SIZE);
+		for (jab_int32 x=0; x<sub_width; x++)
+		{
+			jab_int32 xoffset = MIN(x << BLOCK_SIZE_POWER, bitmap->width - BLOCK_SIZE);
+			//the contrast check is done on all rows, stopping once the dynamic range
+			//is met would give the same result since the range only grows
+			jab_int32 sum[3], min[3], max[3];
+			stats(&bitmap->pixel[yoffset * bytes_per_row + xoffset * bytes_per_pixel], bytes_per_row, bytes_per_pixel, sum, min, max);
+			for (jab_int32 c=0; c<3; c++)
+			{
+				jab_int32 smooth = max[c]-min[c] <= min_dynamic_range;
+				bands->smooth[c][y*sub_width + x] = (jab_byte)smooth;
+				bands->black_points[c][y*sub_width + x] = (jab_byte)(smooth ? min[c] : sum[c] >> (BLOCK_SIZE_POWER * 2));
+			}
+		}
 	}
+}
 
-	//horizontal filtering
-	memcpy(tmp, binary, sizeof(jab_bitmap) + width*height*sizeof(jab_byte));
-	for(jab_int32 i=half_size; i<height-half_size; i++)
+/**
+ * @brief Resolve the black points of smooth blocks in scan order, as they depend on the final black points of their upper and left neighbors
+ * @param bands the binarization state
+*/
+static void resolveSmoothBlocks(jab_binarizer_bands* bands)
+{
+	jab_int32 sub_width = bands->sub_width;
+	for (jab_int32 c=0; c<3; c++)
 	{
-		for(jab_int32 j=half_size; j<width-half_size; j++)
+		jab_byte* black_points = bands->black_points[c];
+		const jab_byte* smooth = bands->smooth[c];
+		for(jab_int32 y=0; y<bands->sub_height; y++)
 		{
-			jab_int32 sum = 0;
-			sum += tmp->pixel[i*width + j] > 0 ? 1 : 0;
-			for(jab_int32 k=1; k<=half_size; k++)
+			for (jab_int32 x=0; x<sub_width; x++)
 			{
-				sum += tmp->pixel[i*width + (j - k)] > 0 ? 1 : 0;
-				sum += tmp->pixel[i*width + (j + k)] > 0 ? 1 : 0;
+				if(!smooth[y*sub_width + x])
+					continue;
+				jab_int32 min = black_points[y*sub_width + x];
+				jab_int32 average = min / 2;
+				if (y > 0 && x > 0)
+				{
+					jab_int32 average_neighbor_blackpoint = (black_points[(y-1) * sub_width + x] +
+															(2 * black_points[y * sub_width + x-1]) +
+															black_points[(y-1) * sub_width + x-1]) / 4;
+					if (min < average_neighbor_blackpoint)
+					{
+						average = average_neighbor_blackpoint;
+					}
+				}
+				black_points[y*sub_width + x] = (jab_byte)average;
 			}
-			binary->pixel[i*width + j] = sum > half_size ? 255 : 0;
 		}
 	}
-	//vertical filtering
-	memcpy(tmp, binary, sizeof(jab_bitmap) + width*height*sizeof(jab_byte));
-	for(jab_int32 i=half_size; i<height-half_size; i++)
+}
+
+/**
+ * @brief Do local binarization of a band of the r, g and b channels
+ * @param context the binarization state
+ * @param index the band index
+ * @param thread_index the index of the executing thread
+*/
+static void getBinaryBitmapBand(void* context, jab_int32 index, jab_int32 thread_index)
+{
+	(void)thread_index;
+	jab_binarizer_bands* bands = (jab_binarizer_bands*)context;
+	if(isBinarizerExpired(bands))
+		return;
+	jab_bitmap* bitmap = bands->bitmap;
+	jab_int32 sub_width = bands->sub_width;
+	jab_int32 sub_height = bands->sub_height;
+
+	jab_int32 bytes_per_pixel = bitmap->bits_per_pixel / 8;
+	jab_int32 bytes_per_row = bitmap->width * bytes_per_pixel;
+
+	//the vector kernels need 4 bytes per pixel
+	void (*threshold)(const jab_byte*, jab_int32, jab_int32, const jab_int32*, jab_byte**, jab_int32) = thresholdBlockGeneric;
+	if (bytes_per_pixel == 4)
+		threshold = __atomic_load_n(&threshold_block_kernel, __ATOMIC_ACQUIRE);
+
+	jab_int32 begin, end;
+	getBlockBand(bands, index, &begin, &end);
+	for (jab_int32 y=begin; y<end; y++)
 	{
-		for(jab_int32 j=half_size; j<width-half_size; j++)
+		jab_int32 yoffset = MIN(y << BLOCK_SIZE_POWER, bitmap->height - BLOCK_SIZE);
+		jab_int32 top = CAP(y, 2, sub_height - 3);
+		for (jab_int32 x=0; x<sub_width; x++)
 		{
-			jab_int32 sum = 0;
-			sum += tmp->pixel[i*width + j] > 0 ? 1 : 0;
-			for(jab_int32 k=1; k<=half_size; k++)
+			jab_int32 xoffset = MIN(x << BLOCK_SIZE_POWER, bitmap->width - BLOCK_SIZE);
+			jab_int32 left = CAP(x, 2, sub_width - 3);
+			jab_int32 average[3];
+			for (jab_int32 c=0; c<3; c++)
 			{
-				sum += tmp->pixel[(i - k)*width + j] > 0 ? 1 : 0;
-				sum += tmp->pixel[(i + k)*width + j] > 0 ? 1 : 0;
+				jab_int32 sum = 0;
+				for (jab_int32 z = -2; z <= 2; z++)
+				{
+					jab_byte* black_row = &bands->black_points[c][(top + z) * sub_width];
+					sum += black_row[left - 2] + black_row[left - 1] + black_row[left] + black_row[left + 1] + black_row[left + 2];
+				}
+				average[c] = sum / 25;
 			}
-			binary->pixel[i*width + j] = sum > half_size ? 255 : 0;
+
+			//threshold block
+			jab_int32 offset = yoffset * bitmap->width + xoffset;
+			jab_byte* dst[3] = {&bands->binary[0]->pixel[offset], &bands->binary[1]->pixel[offset], &bands->binary[2]->pixel[offset]};
+			threshold(&bitmap->pixel[yoffset * bytes_per_row + xoffset * bytes_per_pixel], bytes_per_row, bytes_per_pixel, average, dst, bitmap->width);
+		}
+	}
+}
+
+/**
+ * @brief Filter a band of a binarized channel in horizontal direction
+ * @param context the binarization state
+ * @param index the channel and band index
+ * @param thread_index the index of the executing thread
+*/
+static void filterBandHorizontal(void* context, jab_int32 index, jab_int32 thread_index)
+{
+	(void)thread_index;
+	jab_binarizer_bands* bands = (jab_binarizer_bands*)context;
+	if(isBinarizerExpired(bands))
+		return;
+	jab_bitmap* binary = bands->binary[index / bands->row_bands];
+	jab_int32 begin = (index % bands->row_bands) * BAND_ROWS;
+	jab_byte line[binary->width];
+	filterRowsHorizontal(binary, begin, begin + BAND_ROWS, line);
+}
+
+/**
+ * @brief Filter a band of a binarized channel in vertical direction and pack it
+ * The horizontally filtered rows are only read, so the bands above and below serve as halo rows.
+ * @param context the binarization state
+ * @param index the channel and band index
+ * @param thread_index the index of the executing thread
+*/
+static void filterPackBand(void* context, jab_int32 index, jab_int32 thread_index)
+{
+	(void)thread_index;
+	jab_binarizer_bands* bands = (jab_binarizer_bands*)context;
+	if(isBinarizerExpired(bands))
+		return;
+	jab_bitmap* binary = bands->binary[index / bands->row_bands];
+	jab_bitmap* packed = bands->packed[index / bands->row_bands];
+	jab_int32 width = binary->width;
+	jab_int32 height= binary->height;
+	jab_int32 half_size = FILTER_HALF_SIZE;
+	jab_int32 begin = (index % bands->row_bands) * BAND_ROWS;
+	jab_int32 end = MIN(begin + BAND_ROWS, height);
+
+	jab_byte line[width];
+	jab_byte count[width];
+	//the vertical window counts of the first filtered row without its last row
+	jab_int32 first = MAX(begin, half_size);
+	memset(count, 0, width);
+	for(jab_int32 i=first-half_size; i<first+half_size && i<height; i++)
+	{
+		const jab_byte* row = &binary->pixel[i*width];
+		for(jab_int32 j=0; j<width; j++)
+			count[j] += row[j] > 0;
+	}
+	for(jab_int32 i=begin; i<end; i++)
+	{
+		const jab_byte* row = &binary->pixel[i*width];
+		jab_byte* dst = &packed->pixel[i*BINARY_ROW_BYTES(width)];
+		if(i < half_size || i >= height - half_size)
+		{
+			packRow(row, dst, width);
+			continue;
+		}
+		const jab_byte* next = &binary->pixel[(i + half_size)*width];
+		const jab_byte* prev = &binary->pixel[(i - half_size)*width];
+		jab_int32 j = 0;
+		for(; j+8<=width; j+=8)
+		{
+			jab_uint64 sum = loadBytes(count + j) + nonzeroBytes(loadBytes(next + j));
+			memcpy(count + j, &sum, sizeof(jab_uint64));
+		}
+		for(; j<width; j++)
+			count[j] += next[j] > 0;
+		//the border columns are not filtered
+		memcpy(line, row, width);
+		j = half_size;
+		for(; j+8+half_size<=width; j+=8)
+		{
+			jab_uint64 pixels = majorityBytes(loadBytes(count + j), half_size);
+			memcpy(line + j, &pixels, sizeof(jab_uint64));
+		}
+		for(; j<width-half_size; j++)
+			line[j] = count[j] > half_size ? 255 : 0;
+		packRow(line, dst, width);
+		j = 0;
+		for(; j+8<=width; j+=8)
+		{
+			jab_uint64 sum = loadBytes(count + j) - nonzeroBytes(loadBytes(prev + j));
+			memcpy(count + j, &sum, sizeof(jab_uint64));
+		}
+		for(; j<width; j++)
+			count[j] -= prev[j] > 0;
+	}
+}
+
+/**
+ * @brief Free the buffers of the parallel r, g, b binarization
+ * @param bands the binarization state
+*/
+static void freeBinarizerBands(jab_binarizer_bands* bands)
+{
+	for(jab_int32 i=0; i<3; i++)
+	{
+		free(bands->binary[i]);
+		free(bands->packed[i]);
+	}
+	free(bands->black_points[0]);
+	free(bands->window_sums);
+}
+
+/**
+ * @brief Stop a binarization whose time budget is exceeded
+ * @param bands the binarization state, freed
+ * @return JAB_FAILURE
+*/
+static jab_int32 abortBinarizer(jab_binarizer_bands* bands)
+{
+	reportError("Binarization aborted, time budget exceeded");
+	freeBinarizerBands(bands);
+	return JAB_FAILURE;
+}
+
+/**
+ * @brief Allocate the byte and the bit-packed planes of the r, g, b binarization
+ * @param bands the binarization state
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+static jab_int32 createBinaryPlanes(jab_binarizer_bands* bands)
+{
+	jab_bitmap* bitmap = bands->bitmap;
+	for(jab_int32 i=0; i<3; i++)
+	{
+		bands->binary[i] = (jab_bitmap*)calloc(1, sizeof(jab_bitmap) + bitmap->width*bitmap->height*sizeof(jab_byte));
+		bands->packed[i] = (jab_bitmap*)malloc(sizeof(jab_bitmap) + bitmap->height*BINARY_ROW_BYTES(bitmap->width)*sizeof(jab_byte));
+		if(bands->binary[i] == NULL || bands->packed[i] == NULL)
+		{
+			reportError("Memory allocation for binary bitmap failed");
+			return JAB_FAILURE;
 		}
+		bands->binary[i]->width = bitmap->width;
+		bands->binary[i]->height= bitmap->height;
+		bands->binary[i]->bits_per_channel = 8;
+		bands->binary[i]->bits_per_pixel = 8;
+		bands->binary[i]->channel_count = 1;
+		bands->packed[i]->width = bitmap->width;
+		bands->packed[i]->height= bitmap->height;
+		bands->packed[i]->bits_per_channel = 1;
+		bands->packed[i]->bits_per_pixel = 1;
+		bands->packed[i]->channel_count = 1;
 	}
-	free(tmp);
+	return JAB_SUCCESS;
 }
 
 /**
- * @brief Binarize a color channel of a bitmap using local binarization algorithm
+ * @brief Pack the binarized r, g and b channels
+ * @param rgb the binary bitmaps of the three channels, freed if failed
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+static jab_int32 packBinaryRGB(jab_bitmap* rgb[3])
+{
+	jab_int32 failed = 0;
+	for(jab_int32 i=0; i<3; i++)
+	{
+		rgb[i] = packBinary(rgb[i]);
+		failed |= rgb[i] == NULL;
+	}
+	if(failed)
+	{
+		for(jab_int32 i=0; i<3; i++)
+		{
+			free(rgb[i]);
+			rgb[i] = NULL;
+		}
+		return JAB_FAILURE;
+	}
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Binarize the r, g and b channels of a bitmap together using local binarization algorithm
+ * The colors are enhanced while the pixels are read, see enhancePixel.
  * @param bitmap the input bitmap
- * @param channel the color channel
- * @return binarized bitmap | NULL if failed
+ * @param rgb the bit-packed binarized bitmaps of the three channels
+ * @param deadline the time in microseconds after which the binarization is aborted, 0 for no limit
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_int32 binarizerRGB(jab_bitmap* bitmap, jab_bitmap* rgb[3], jab_uint64 deadline)
+{
+	rgb[0] = rgb[1] = rgb[2] = NULL;
+	if(bitmap->width < MINIMUM_DIMENSION || bitmap->height < MINIMUM_DIMENSION)
+	{
+		//if the bitmap is too small, use the global histogram-based method on an enhanced copy
+		jab_int32 bytes_per_pixel = bitmap->bits_per_pixel / 8;
+		jab_bitmap* enhanced = (jab_bitmap*)malloc(sizeof(jab_bitmap) + bitmap->width*bitmap->height*bytes_per_pixel*sizeof(jab_byte));
+		if(enhanced == NULL)
+		{
+			reportError("Memory allocation for enhanced bitmap failed");
+			return JAB_FAILURE;
+		}
+		memcpy(enhanced, bitmap, sizeof(jab_bitmap));
+		enhancePixels(bitmap->pixel, enhanced->pixel, bitmap->width*bitmap->height, bytes_per_pixel);
+		for(jab_int32 i=0; i<3; i++)
+		{
+			rgb[i] = binarizerHist(enhanced, i);
+			if(rgb[i] == NULL)
+			{
+				for(jab_int32 j=0; j<i; free(rgb[j++]));
+				free(enhanced);
+				return JAB_FAILURE;
+			}
+		}
+		free(enhanced);
+		return packBinaryRGB(rgb);
+	}
+
+	jab_binarizer_bands bands;
+	memset(&bands, 0, sizeof(jab_binarizer_bands));
+	bands.bitmap = bitmap;
+	bands.deadline = deadline;
+	bands.sub_width = bitmap->width >> BLOCK_SIZE_POWER;
+	if((bands.sub_width & BLOCK_SIZE_MASK) != 0 )	bands.sub_width++;
+	bands.sub_height= bitmap->height>> BLOCK_SIZE_POWER;
+	if((bands.sub_height& BLOCK_SIZE_MASK) != 0 )	bands.sub_height++;
+	//a band may only start at a block row that is not clamped to the bitmap bottom, so that no pixel row is thresholded by two bands
+	for(bands.block_bands=1; bands.block_bands*BAND_BLOCK_ROWS < bands.sub_height &&
+		((bands.block_bands*BAND_BLOCK_ROWS) << BLOCK_SIZE_POWER) <= bitmap->height - BLOCK_SIZE; bands.block_bands++);
+	bands.row_bands = (bitmap->height + BAND_ROWS - 1) / BAND_ROWS;
+
+	jab_int32 blocks = bands.sub_width * bands.sub_height;
+	jab_byte* grids = (jab_byte*)malloc(6 * blocks * sizeof(jab_byte));
+	if(grids == NULL)
+	{
+		reportError("Memory allocation for black points failed");
+		return JAB_FAILURE;
+	}
+	for(jab_int32 i=0; i<3; i++)
+	{
+		bands.black_points[i] = grids + i * blocks;
+		bands.smooth[i] = grids + (3 + i) * blocks;
+	}
+	if(!createBinaryPlanes(&bands))
+	{
+		freeBinarizerBands(&bands);
+		return JAB_FAILURE;
+	}
+
+	//each step depends on the complete result of the previous one, the bands check the time budget
+	selectBlockKernels();
+	jab_int32 threads = getThreadNumber();
+	runParallel(calculateBlackPointsBand, &bands, bands.block_bands, threads);
+	if(isBinarizerExpired(&bands))
+		return abortBinarizer(&bands);
+	resolveSmoothBlocks(&bands);
+	runParallel(getBinaryBitmapBand, &bands, bands.block_bands, threads);
+	if(isBinarizerExpired(&bands))
+		return abortBinarizer(&bands);
+	runParallel(filterBandHorizontal, &bands, 3 * bands.row_bands, threads);
+	if(isBinarizerExpired(&bands))
+		return abortBinarizer(&bands);
+	runParallel(filterPackBand, &bands, 3 * bands.row_bands, threads);
+	if(isBinarizerExpired(&bands))
+		return abortBinarizer(&bands);
+	for(jab_int32 i=0; i<3; i++)
+	{
+		rgb[i] = bands.packed[i];
+		bands.packed[i] = NULL;
+	}
+	freeBinarizerBands(&bands);
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Move the column sums of the r, g and b channels by one row
+ * @param column the column sums
+ * @param entering the pixel row entering the window | NULL
+ * @param leaving the pixel row leaving the window | NULL
+ * @param width the row width
+ * @param bytes_per_pixel the number of bytes per pixel
 */
-jab_bitmap* binarizer(jab_bitmap* bitmap, jab_int32 channel)
+static void updateColumnSums(jab_uint32* column, const jab_byte* entering, const jab_byte* leaving, jab_int32 width, jab_int32 bytes_per_pixel)
 {
-	if(bitmap->width >= MINIMUM_DIMENSION && bitmap->height >= MINIMUM_DIMENSION)
+	jab_int32 in[3], out[3];
+	if(entering && leaving)
+	{
+		for(jab_int32 j=0; j<width; j++)
+		{
+			enhancePixel(&entering[j*bytes_per_pixel], in);
+			enhancePixel(&leaving[j*bytes_per_pixel], out);
+			for(jab_int32 c=0; c<3; c++)
+				column[j*3 + c] += in[c] - out[c];
+		}
+	}
+	else if(entering)
+	{
+		for(jab_int32 j=0; j<width; j++)
+		{
+			enhancePixel(&entering[j*bytes_per_pixel], in);
+			for(jab_int32 c=0; c<3; c++)
+				column[j*3 + c] += in[c];
+		}
+	}
+	else if(leaving)
 	{
-		jab_int32 sub_width = bitmap->width >> BLOCK_SIZE_POWER;
-		if((sub_width & BLOCK_SIZE_MASK) != 0 )	sub_width++;
-		jab_int32 sub_height= bitmap->height>> BLOCK_SIZE_POWER;
-		if((sub_height& BLOCK_SIZE_MASK) != 0 )	sub_height++;
+		for(jab_int32 j=0; j<width; j++)
+		{
+			enhancePixel(&leaving[j*bytes_per_pixel], out);
+			for(jab_int32 c=0; c<3; c++)
+				column[j*3 + c] -= out[c];
+		}
+	}
+}
 
-		jab_byte* black_points = (jab_byte*)malloc(sub_width * sub_height * sizeof(jab_byte));
-		if(black_points == NULL)
+/**
+ * @brief Threshold a band of the r, g and b channels against the mean of a square window around each pixel
+ * The window sums are differences of the summed-area table rows, which are built from running column sums,
+ * so the cost per pixel does not depend on the window size.
+ * @param context the binarization state
+ * @param index the band index
+ * @param thread_index the index of the executing thread
+*/
+static void thresholdIntegralBand(void* context, jab_int32 index, jab_int32 thread_index)
+{
+	jab_binarizer_bands* bands = (jab_binarizer_bands*)context;
+	if(isBinarizerExpired(bands))
+		return;
+	jab_bitmap* bitmap = bands->bitmap;
+	jab_int32 width = bitmap->width;
+	jab_int32 height= bitmap->height;
+	jab_int32 radius = bands->radius;
+	jab_int32 bytes_per_pixel = bitmap->bits_per_pixel / 8;
+	jab_int32 bytes_per_row = width * bytes_per_pixel;
+	jab_int32 begin = index * bands->integral_rows;
+	jab_int32 end = MIN(begin + bands->integral_rows, height);
+
+	//the sums wrap around, only the differences of the table entries are used and they fit into 32 bits
+	jab_uint32* column = &bands->window_sums[thread_index * 3 * (2 * width + 1)];
+	jab_uint32* table = column + 3 * width;
+	//the column sums of the window of the row above the band
+	memset(column, 0, 3 * width * sizeof(jab_uint32));
+	for(jab_int32 i=MAX(begin-radius-1, 0); i<MIN(begin+radius, height); i++)
+		updateColumnSums(column, &bitmap->pixel[i * bytes_per_row], NULL, width, bytes_per_pixel);
+	table[0] = table[1] = table[2] = 0;
+	for(jab_int32 i=begin; i<end; i++)
+	{
+		const jab_byte* entering = i + radius < height ? &bitmap->pixel[(i + radius) * bytes_per_row] : NULL;
+		const jab_byte* leaving = i - radius - 1 >= 0 ? &bitmap->pixel[(i - radius - 1) * bytes_per_row] : NULL;
+		updateColumnSums(column, entering, leaving, width, bytes_per_pixel);
+		//the summed-area table row of the window rows
+		jab_uint32 row_sum[3] = {0, 0, 0};
+		for(jab_int32 j=0; j<width; j++)
 		{
-			reportError("Memory allocation for black points failed");
-			return NULL;
+			for(jab_int32 c=0; c<3; c++)
+			{
+				row_sum[c] += column[j*3 + c];
+				table[(j + 1)*3 + c] = row_sum[c];
+			}
 		}
-		calculateBlackPoints(bitmap, channel, sub_width, sub_height, black_points);
 
-		jab_bitmap* binary = (jab_bitmap*)calloc(1, sizeof(jab_bitmap) + bitmap->width*bitmap->height*sizeof(jab_byte));
-		if(binary == NULL)
+		jab_uint64 rows = MIN(i + radius, height - 1) - MAX(i - radius, 0) + 1;
+		const jab_byte* src = &bitmap->pixel[i * bytes_per_row];
+		jab_byte* dst[3] = {&bands->binary[0]->pixel[i * width], &bands->binary[1]->pixel[i * width], &bands->binary[2]->pixel[i * width]};
+		for(jab_int32 j=0; j<width; j++)
 		{
-			reportError("Memory allocation for binary bitmap failed");
-			return NULL;
+			jab_int32 left = MAX(j - radius, 0);
+			jab_int32 right= MIN(j + radius, width - 1);
+			//the pixel is bright if pixel * count > mean * count * (100 - percent) / 100
+			jab_uint64 count = rows * (jab_uint64)(right - left + 1) * 100;
+			const jab_uint32* sum_left = &table[left * 3];
+			const jab_uint32* sum_right= &table[(right + 1) * 3];
+			jab_int32 rgb[3];
+			enhancePixel(&src[j*bytes_per_pixel], rgb);
+			for(jab_int32 c=0; c<3; c++)
+			{
+				jab_uint64 sum = sum_right[c] - sum_left[c];
+				dst[c][j] = (jab_uint64)rgb[c] * count > sum * (100 - INTEGRAL_THRESHOLD_PERCENT) ? 255 : 0;
+			}
 		}
-		binary->width = bitmap->width;
-		binary->height= bitmap->height;
-		binary->bits_per_channel = 8;
-		binary->bits_per_pixel = 8;
-		binary->channel_count = 1;
-		getBinaryBitmap(bitmap, channel, sub_width, sub_height, black_points, binary);
+	}
+}
 
-		filterBinary(binary);
+/**
+ * @brief Binarize the r, g and b channels of a bitmap against the local mean of each pixel
+ * Unlike the block binarizer, the window size is free and does not change the runtime.
+ * The colors are enhanced while the pixels are read, see enhancePixel.
+ * @param bitmap the input bitmap
+ * @param rgb the bit-packed binarized bitmaps of the three channels
+ * @param radius the window radius, 0 for the default
+ * @param deadline the time in microseconds after which the binarization is aborted, 0 for no limit
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_int32 binarizerIntegral(jab_bitmap* bitmap, jab_bitmap* rgb[3], jab_int32 radius, jab_uint64 deadline)
+{
+	rgb[0] = rgb[1] = rgb[2] = NULL;
+	jab_binarizer_bands bands;
+	memset(&bands, 0, sizeof(jab_binarizer_bands));
+	bands.bitmap = bitmap;
+	bands.deadline = deadline;
+	bands.radius = radius > 0 ? MIN(radius, INTEGRAL_MAX_RADIUS) : INTEGRAL_DEFAULT_RADIUS;
+	bands.row_bands = (bitmap->height + BAND_ROWS - 1) / BAND_ROWS;
+	//each band first sums up the window rows above its first row, large bands keep that at most the band cost
+	bands.integral_rows = MAX((2 * bands.radius + BAND_ROWS - 1) / BAND_ROWS, 1) * BAND_ROWS;
 
-		free(black_points);
-		return binary;
+	//one window sum buffer per thread, the thread number is read once so that it matches the buffers
+	jab_int32 threads = getThreadNumber();
+	bands.window_sums = (jab_uint32*)malloc(threads * 3 * (2 * bitmap->width + 1) * sizeof(jab_uint32));
+	if(bands.window_sums == NULL)
+	{
+		reportError("Memory allocation for window sums failed");
+		return JAB_FAILURE;
 	}
-	else
+	if(!createBinaryPlanes(&bands))
+	{
+		freeBinarizerBands(&bands);
+		return JAB_FAILURE;
+	}
+
+	//the bands check the time budget
+	runParallel(thresholdIntegralBand, &bands, (bitmap->height + bands.integral_rows - 1) / bands.integral_rows, threads);
+	if(isBinarizerExpired(&bands))
+		return abortBinarizer(&bands);
+	runParallel(filterBandHorizontal, &bands, 3 * bands.row_bands, threads);
+	if(isBinarizerExpired(&bands))
+		return abortBinarizer(&bands);
+	runParallel(filterPackBand, &bands, 3 * bands.row_bands, threads);
+	if(isBinarizerExpired(&bands))
+		return abortBinarizer(&bands);
+	for(jab_int32 i=0; i<3; i++)
 	{
-		//if the bitmap is too small, use the global histogram-based method
-		return binarizerHist(bitmap, channel);
+		rgb[i] = bands.packed[i];
+		bands.packed[i] = NULL;
 	}
+	freeBinarizerBands(&bands);
+	return JAB_SUCCESS;
 }
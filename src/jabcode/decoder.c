@@ -1084,7 +1084,7 @@ jab_int32 decodeMasterMetadata(jab_bitmap* matrix, jab_decoded_symbol* symbol, j
 		getNextMetadataModuleInMaster(matrix->height, matrix->width, module_count, &x, &y);
 	}
 	//decode ldpc for part1
-	if( !decodeLDPChd(part1, part1_bit_length, part1_bit_length > 36 ? 4 : 3, 0) )
+	if( !decodeLDPChd(part1, part1_bit_length, part1_bit_length > 36 ? 4 : 3, 0, 0) )
 	{
 		reportError("LDPC decoding for master metadata part 1 failed");
 		return -1;
@@ -1839,9 +1839,10 @@ void fillDataMap(jab_byte* data_map, jab_int32 width, jab_int32 height, jab_int3
  * @brief Decode master symbol
  * @param matrix the symbol matrix
  * @param symbol the master symbol
+ * @param deadline the time in microseconds after which the data decoding is aborted, 0 for no limit
  * @return 1: success | 0: decoding data failure | -1: decoding metadata failure | -2: fatal failure (out of memory)
 */
-jab_int32 decodeMaster(jab_bitmap* matrix, jab_decoded_symbol* symbol)
+jab_int32 decodeMaster(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_uint64 deadline)
 {
 	if(matrix == NULL)
 	{
@@ -1917,7 +1918,7 @@ jab_int32 decodeMaster(jab_bitmap* matrix, jab_decoded_symbol* symbol)
 
 	//decode ldpc
     //if(decodeLDPC(bits_p, Pg, symbol->metadata.ecl.x, symbol->metadata.ecl.y, (jab_byte*)raw_data->data) != Pn)
-    if(decodeLDPChd((jab_byte*)raw_data->data, Pg, symbol->metadata.ecl.x, symbol->metadata.ecl.y) != Pn)
+    if(decodeLDPChd((jab_byte*)raw_data->data, Pg, symbol->metadata.ecl.x, symbol->metadata.ecl.y, deadline) != Pn)
     {
 		reportError("LDPC decoding for data in master failed");
 		free(raw_data);
@@ -1946,9 +1947,10 @@ jab_int32 decodeMaster(jab_bitmap* matrix, jab_decoded_symbol* symbol)
  * @brief Decode slave symbol
  * @param matrix the symbol matrix
  * @param symbol the slave symbol
+ * @param deadline the time in microseconds after which the data decoding is aborted, 0 for no limit
  * @return 1: success | 0: decoding data failure | -1: decoding metadata failure | -2: fatal failure (out of memory)
 */
-jab_int32 decodeSlave(jab_bitmap* matrix, jab_decoded_symbol* symbol)
+jab_int32 decodeSlave(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_uint64 deadline)
 {
 	if(matrix == NULL)
 	{
@@ -2132,7 +2134,7 @@ jab_int32 decodeSlave(jab_bitmap* matrix, jab_decoded_symbol* symbol)
 
 	//decode ldpc
 //	if(decodeLDPC(bits_p, Pg, symbol->metadata.ecl.x, symbol->metadata.ecl.y, (jab_byte*)raw_data->data) != Pn)
-    if(decodeLDPChd((jab_byte*)raw_data->data, Pg, symbol->metadata.ecl.x, symbol->metadata.ecl.y) != Pn)
+    if(decodeLDPChd((jab_byte*)raw_data->data, Pg, symbol->metadata.ecl.x, symbol->metadata.ecl.y, deadline) != Pn)
 	{
 		reportError("LDPC decoding for data in slave failed");
 		free(raw_data);
@@ -72,8 +72,8 @@ typedef enum {
 	FNC1
 }jab_encode_mode;
 
-extern jab_int32 decodeMaster(jab_bitmap* matrix, jab_decoded_symbol* symbol);
-extern jab_int32 decodeSlave(jab_bitmap* matrix, jab_decoded_symbol* symbol);
+extern jab_int32 decodeMaster(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_uint64 deadline);
+extern jab_int32 decodeSlave(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_uint64 deadline);
 extern jab_boolean decodeSlaveMetadata(jab_bitmap* matrix, jab_decoded_symbol* host_symbol, jab_decoded_symbol* slave_symbol);
 extern jab_data* decodeData(jab_data* bits);
 extern void deinterleaveData(jab_data* data, jab_float* p);
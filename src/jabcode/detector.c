@@ -19,6 +19,7 @@
 #include "detector.h"
 #include "decoder.h"
 #include "encoder.h"
+#include "parallel.h"
 
 /**
  * @brief Check the proportion of layer sizes in finder pattern
@@ -71,9 +72,109 @@ jab_boolean checkModuleSize(jab_float size_r, jab_float size_g, jab_float size_b
 	return condition;
 }
 
+/**
+ * @brief Move to the left over the run of pixels with the same color in a bit-packed row
+ * @param row the bit-packed bitmap row
+ * @param x the position in the run
+ * @param min the minimal position
+ * @return the first position on the left with a different color | min if there is none
+*/
+jab_int32 skipRunLeft(const jab_byte* row, jab_int32 x, jab_int32 min)
+{
+    jab_int32 start = findRunStart(row, x, min);
+    return start > min ? start - 1 : min;
+}
+
+/**
+ * @brief Count the layer sizes along a bit-packed row from a start position in one direction
+ * @param row the bit-packed bitmap row
+ * @param startx the start position, which is already counted
+ * @param limit the last position to scan
+ * @param step the scan direction, -1 for left and 1 for right
+ * @param state_count the layer sizes, counted from state_middle in scan direction
+ * @param state_middle the index of the middle layer
+ * @param length the offset of the first pixel that was not scanned
+ * @return the number of passed layer changes
+*/
+jab_int32 scanRowLayers(const jab_byte* row, jab_int32 startx, jab_int32 limit, jab_int32 step, jab_int32* state_count, jab_int32 state_middle, jab_int32* length)
+{
+    jab_int32 last = step * (limit - startx);
+    jab_int32 i, state_index;
+    for(i=1, state_index=0; i<=last && state_index<=state_middle; i++)
+    {
+        //the pixels up to the next color change have the same color as the preceding pixel
+        jab_int32 x = startx + step * (i-1);
+        jab_int32 change = step > 0 ? findRunEnd(row, x, limit + 1) : findRunStart(row, x, limit) - 1;
+        jab_int32 same = step * (change - x) - 1;
+        state_count[state_middle + step * state_index] += same;
+        i += same;
+        if(i > last) break;
+
+        if(state_index > 0 && state_count[state_middle + step * state_index] < 3)
+        {
+            state_count[state_middle + step * (state_index-1)] += state_count[state_middle + step * state_index];
+            state_count[state_middle + step * state_index] = 0;
+            state_index--;
+            state_count[state_middle + step * state_index]++;
+        }
+        else
+        {
+            state_index++;
+            if(state_index > state_middle) break;
+            else state_count[state_middle + step * state_index]++;
+        }
+    }
+    *length = i;
+    return state_index;
+}
+
+/**
+ * @brief Count the layer sizes along the runs of a row from a start position in one direction
+ * @param runs the runs of the row
+ * @param run the index of the run containing the start position
+ * @param startx the start position, which is already counted
+ * @param limit the last position to scan
+ * @param step the scan direction, 1 or -1
+ * @param state_count the layer sizes, indexed from the middle layer
+ * @param state_middle the index of the middle layer
+ * @param length the offset of the first pixel that was not scanned
+ * @return the number of passed layer changes
+*/
+jab_int32 scanRunLayers(const jab_row_runs* runs, jab_int32 run, jab_int32 startx, jab_int32 limit, jab_int32 step, jab_int32* state_count, jab_int32 state_middle, jab_int32* length)
+{
+    jab_int32 last = step * (limit - startx);
+    jab_int32 i, state_index;
+    for(i=1, state_index=0; i<=last && state_index<=state_middle; i++, run+=step)
+    {
+        //the pixels up to the border of the current run have the same color as the preceding pixel
+        jab_int32 x = startx + step * (i-1);
+        jab_int32 change = step > 0 ? MIN(runs->start[run+1], limit + 1) : MAX(runs->start[run], limit) - 1;
+        jab_int32 same = step * (change - x) - 1;
+        state_count[state_middle + step * state_index] += same;
+        i += same;
+        if(i > last) break;
+
+        if(state_index > 0 && state_count[state_middle + step * state_index] < 3)
+        {
+            state_count[state_middle + step * (state_index-1)] += state_count[state_middle + step * state_index];
+            state_count[state_middle + step * state_index] = 0;
+            state_index--;
+            state_count[state_middle + step * state_index]++;
+        }
+        else
+        {
+            state_index++;
+            if(state_index > state_middle) break;
+            else state_count[state_middle + step * state_index]++;
+        }
+    }
+    *length = i;
+    return state_index;
+}
+
 /**
  * @brief Find a candidate scanline of finder pattern
- * @param row the bitmap row
+ * @param runs the runs of the bitmap row
  * @param channel the color channel
  * @param startx the start position
  * @param endx the end position
@@ -82,7 +183,7 @@ jab_boolean checkModuleSize(jab_float size_r, jab_float size_g, jab_float size_b
  * @param skip the length of pixels to be skipped in the next scan
  * @return JAB_SUCCESS | JAB_FAILURE
 */
-jab_boolean seekPattern(jab_byte* row, jab_int32 channel, jab_int32* startx, jab_int32* endx, jab_float* centerx, jab_float* module_size, jab_int32* skip)
+jab_boolean seekPattern(jab_row_runs* runs, jab_int32 channel, jab_int32* startx, jab_int32* endx, jab_float* centerx, jab_float* module_size, jab_int32* skip)
 {
     jab_int32 state_number = 5;
     jab_int32 cur_state = 0;
@@ -90,85 +191,87 @@ jab_boolean seekPattern(jab_byte* row, jab_int32 channel, jab_int32* startx, jab
 
     jab_int32 min = *startx;
     jab_int32 max = *endx;
-    for(jab_int32 j=min; j<max; j++)
+    if(min >= max)
     {
-        //first pixel in a scanline
-        if(j == min)
-        {
+        if(channel == 0) *endx = max;
+        return JAB_FAILURE;
+    }
+    //first pixel in a scanline
+    state_count[cur_state]++;
+    if(channel == 0) *startx = min;
+    //jump from one run to the next, the last pixel in the scanline is also handled as a change
+    jab_int32 j = min;
+    jab_int32 run = findRunIndex(runs, min);
+    while(j < max-1)
+    {
+        jab_int32 next = runs->start[++run];
+        //the last pixel continues the run if the next run starts behind it
+        jab_boolean same = next >= max;
+        if(same) next = max-1;
+        //the pixels before the change have the same color as the preceding pixel
+        state_count[cur_state] += next - j - 1;
+        j = next;
+        //the last pixel is counted as well if it has the same color
+        if(same)
             state_count[cur_state]++;
-            if(channel == 0) *startx = j;
+
+        //change state
+        if(cur_state < state_number-1)
+        {
+            //check if the current state is valid
+            if(state_count[cur_state] < 3)
+            {
+                if(cur_state == 0)
+                {
+                    state_count[cur_state]=1;
+                    if(channel == 0) *startx = j;
+                }
+                else
+                {
+                    //combine the current state to the previous one and continue the previous state
+                    state_count[cur_state-1] += state_count[cur_state];
+                    state_count[cur_state] = 0;
+                    cur_state--;
+                    state_count[cur_state]++;
+                }
+            }
+            else
+            {
+                //enter the next state
+                cur_state++;
+                state_count[cur_state]++;
+            }
         }
+        //find a candidate
         else
         {
-            //the pixel has the same color as the preceding pixel
-            if(row[j] == row[j-1])
+            if(state_count[cur_state] < 3)
             {
+                //combine the current state to the previous one and continue the previous state
+                state_count[cur_state-1] += state_count[cur_state];
+                state_count[cur_state] = 0;
+                cur_state--;
                 state_count[cur_state]++;
+                continue;
             }
-            //the pixel has different color from the preceding pixel
-            if(row[j] != row[j-1] || j == max-1)
+            //check if it is a valid finder pattern
+            if(checkPatternCross(state_count, module_size))
             {
-                //change state
-                if(cur_state < state_number-1)
-                {
-                    //check if the current state is valid
-                    if(state_count[cur_state] < 3)
-                    {
-                        if(cur_state == 0)
-                        {
-                            state_count[cur_state]=1;
-                            if(channel == 0) *startx = j;
-                        }
-                        else
-                        {
-                            //combine the current state to the previous one and continue the previous state
-                            state_count[cur_state-1] += state_count[cur_state];
-                            state_count[cur_state] = 0;
-                            cur_state--;
-                            state_count[cur_state]++;
-                        }
-                    }
-                    else
-                    {
-                        //enter the next state
-                        cur_state++;
-                        state_count[cur_state]++;
-                    }
-                }
-                //find a candidate
-                else
+                if(channel == 0) *endx = j+1;
+                if(channel == 0 && skip)  *skip = state_count[0];
+                jab_int32 end = same ? j + 1 : j;
+                *centerx = (jab_float)(end - state_count[4] - state_count[3]) - (jab_float)state_count[2] / 2.0f;
+                return JAB_SUCCESS;
+            }
+            else //check failed, update state_count
+            {
+                if(channel == 0) *startx += state_count[0];
+                for(jab_int32 k=0; k<state_number-1; k++)
                 {
-                    if(state_count[cur_state] < 3)
-                    {
-                        //combine the current state to the previous one and continue the previous state
-                        state_count[cur_state-1] += state_count[cur_state];
-                        state_count[cur_state] = 0;
-                        cur_state--;
-                        state_count[cur_state]++;
-                        continue;
-                    }
-                    //check if it is a valid finder pattern
-                    if(checkPatternCross(state_count, module_size))
-                    {
-                        if(channel == 0) *endx = j+1;
-                        if(channel == 0 && skip)  *skip = state_count[0];
-						jab_int32 end;
-						if(j == (max - 1) && row[j] == row[j-1]) end = j + 1;
-						else end = j;
-						*centerx = (jab_float)(end - state_count[4] - state_count[3]) - (jab_float)state_count[2] / 2.0f;
-                        return JAB_SUCCESS;
-                    }
-                    else //check failed, update state_count
-                    {
-                        if(channel == 0) *startx += state_count[0];
-                        for(jab_int32 k=0; k<state_number-1; k++)
-                        {
-                            state_count[k] = state_count[k+1];
-                        }
-                        state_count[state_number-1] = 1;
-                        cur_state = state_number-1;
-                    }
+                    state_count[k] = state_count[k+1];
                 }
+                state_count[state_number-1] = 1;
+                cur_state = state_number-1;
             }
         }
     }
@@ -242,7 +345,7 @@ jab_float crossCheckPatternDiagonal(jab_bitmap* image, jab_int32 type, jab_float
         state_count[state_middle]++;
         for(i=1, state_index=0; (starty+i*offset_y)>=0 && (starty+i*offset_y)<image->height && (startx+i*offset_x)>=0 && (startx+i*offset_x)<image->width && state_index<=state_middle; i++)
         {
-            if( image->pixel[(starty + i*offset_y)*image->width + (startx + i*offset_x)] == image->pixel[(starty + (i-1)*offset_y)*image->width + (startx + (i-1)*offset_x)] )
+            if( getBinaryPixel(image, startx + i*offset_x, starty + i*offset_y) == getBinaryPixel(image, startx + (i-1)*offset_x, starty + (i-1)*offset_y) )
             {
                 state_count[state_middle - state_index]++;
             }
@@ -279,7 +382,7 @@ jab_float crossCheckPatternDiagonal(jab_bitmap* image, jab_int32 type, jab_float
 		{
 			for(i=1, state_index=0; (starty-i*offset_y)>=0 && (starty-i*offset_y)<image->height && (startx-i*offset_x)>=0 && (startx-i*offset_x)<image->width && state_index<=state_middle; i++)
 			{
-				if( image->pixel[(starty - i*offset_y)*image->width + (startx - i*offset_x)] == image->pixel[(starty - (i-1)*offset_y)*image->width + (startx - (i-1)*offset_x)] )
+				if( getBinaryPixel(image, startx - i*offset_x, starty - i*offset_y) == getBinaryPixel(image, startx - (i-1)*offset_x, starty - (i-1)*offset_y) )
 				{
 					state_count[state_middle + state_index]++;
 				}
@@ -357,7 +460,7 @@ jab_float crossCheckPatternVertical(jab_bitmap* image, jab_point center, jab_int
     state_count[1]++;
     for(i=1, state_index=0; i<=centery && state_index<=state_middle; i++)
     {
-        if( image->pixel[(centery-i)*image->width + centerx] == image->pixel[(centery-(i-1))*image->width + centerx] )
+        if( getBinaryPixel(image, centerx, centery-i) == getBinaryPixel(image, centerx, centery-(i-1)) )
         {
             state_count[state_middle - state_index]++;
         }
@@ -383,7 +486,7 @@ jab_float crossCheckPatternVertical(jab_bitmap* image, jab_point center, jab_int
 
     for(i=1, state_index=0; (centery+i)<image->height && state_index<=state_middle; i++)
     {
-        if( image->pixel[(centery+i)*image->width + centerx] == image->pixel[(centery+(i-1))*image->width + centerx] )
+        if( getBinaryPixel(image, centerx, centery+i) == getBinaryPixel(image, centerx, centery+(i-1)) )
         {
             state_count[state_middle + state_index]++;
         }
@@ -421,72 +524,36 @@ jab_float crossCheckPatternVertical(jab_bitmap* image, jab_point center, jab_int
 /**
  * @brief Crosscheck the finder pattern candidate in horizontal direction
  * @param image the image bitmap
+ * @param runs the runs of the row at centery | NULL to scan the bit-packed row
  * @param module_size_max the maximal allowed module size
  * @param centerx the x coordinate of the finder pattern center
  * @param centery the y coordinate of the finder pattern center
  * @param module_size the module size in horizontal direction
  * @return JAB_SUCCESS | JAB_FAILURE
 */
-jab_boolean crossCheckPatternHorizontal(jab_bitmap* image, jab_float module_size_max, jab_float* centerx, jab_float centery, jab_float* module_size)
+jab_boolean crossCheckPatternHorizontal(jab_bitmap* image, jab_row_runs* runs, jab_float module_size_max, jab_float* centerx, jab_float centery, jab_float* module_size)
 {
     jab_int32 state_number = 5;
     jab_int32 state_middle = (state_number - 1) / 2;
     jab_int32 state_count[5] = {0};
 
     jab_int32 startx = (jab_int32)(*centerx);
-    jab_int32 offset = (jab_int32)centery * image->width;
+    const jab_byte* row = getBinaryRow(image, (jab_int32)centery);
+    jab_int32 run = runs ? findRunIndex(runs, startx) : 0;
     jab_int32 i, state_index;
 
     state_count[state_middle]++;
-    for(i=1, state_index=0; i<=startx && state_index<=state_middle; i++)
-    {
-        if( image->pixel[offset + (startx - i)] == image->pixel[offset + (startx - (i-1))] )
-        {
-            state_count[state_middle - state_index]++;
-        }
-        else
-        {
-            if(state_index > 0 && state_count[state_middle - state_index] < 3)
-            {
-                state_count[state_middle - (state_index-1)] += state_count[state_middle - state_index];
-                state_count[state_middle - state_index] = 0;
-                state_index--;
-                state_count[state_middle - state_index]++;
-            }
-            else
-            {
-                state_index++;
-                if(state_index > state_middle) break;
-                else state_count[state_middle - state_index]++;
-            }
-        }
-    }
+    if(runs)
+        state_index = scanRunLayers(runs, run, startx, 0, -1, state_count, state_middle, &i);
+    else
+        state_index = scanRowLayers(row, startx, 0, -1, state_count, state_middle, &i);
     if(state_index < state_middle)
         return JAB_FAILURE;
 
-    for(i=1, state_index=0; (startx+i)<image->width && state_index<=state_middle; i++)
-    {
-        if( image->pixel[offset + (startx + i)] == image->pixel[offset + (startx + (i-1))] )
-        {
-            state_count[state_middle + state_index]++;
-        }
-        else
-        {
-            if(state_index > 0 && state_count[state_middle + state_index] < 3)
-            {
-                state_count[state_middle + (state_index-1)] += state_count[state_middle + state_index];
-                state_count[state_middle + state_index] = 0;
-                state_index--;
-                state_count[state_middle + state_index]++;
-            }
-            else
-            {
-                state_index++;
-                if(state_index > state_middle) break;
-                else state_count[state_middle + state_index]++;
-            }
-        }
-    }
+    if(runs)
+        state_index = scanRunLayers(runs, run, startx, image->width - 1, 1, state_count, state_middle, &i);
+    else
+        state_index = scanRowLayers(row, startx, image->width - 1, 1, state_count, state_middle, &i);
     if(state_index < state_middle)
         return JAB_FAILURE;
 
@@ -520,7 +587,7 @@ jab_boolean crossCheckPattern(jab_bitmap* ch[], jab_finder_pattern* fp)
     centery_r = crossCheckPatternVertical(ch[0], fp->center, module_size_max, &module_size_rv);
     if(centery_r < 0)
 		return JAB_FAILURE;
-	if(!crossCheckPatternHorizontal(ch[0], module_size_max, &centerx_r, centery_r, &module_size_rh))
+	if(!crossCheckPatternHorizontal(ch[0], NULL, module_size_max, &centerx_r, centery_r, &module_size_rh))
 		return JAB_FAILURE;
 	if(crossCheckPatternDiagonal(ch[0], fp->type, module_size_max, fp->center, &dir_r) < 0)
 		return JAB_FAILURE;
@@ -532,7 +599,7 @@ jab_boolean crossCheckPattern(jab_bitmap* ch[], jab_finder_pattern* fp)
     centery_g = crossCheckPatternVertical(ch[1], fp->center, module_size_max, &module_size_gv);
     if(centery_g < 0)
 		return JAB_FAILURE;
-	if(!crossCheckPatternHorizontal(ch[1], module_size_max, &centerx_g, centery_g, &module_size_gh))
+	if(!crossCheckPatternHorizontal(ch[1], NULL, module_size_max, &centerx_g, centery_g, &module_size_gh))
 		return JAB_FAILURE;
 	if(crossCheckPatternDiagonal(ch[1], fp->type, module_size_max, fp->center, &dir_g) < 0)
 		return JAB_FAILURE;
@@ -544,7 +611,7 @@ jab_boolean crossCheckPattern(jab_bitmap* ch[], jab_finder_pattern* fp)
 	centery_b = crossCheckPatternVertical(ch[2], fp->center, module_size_max, &module_size_bv);
 	if(centery_b < 0)
 		return JAB_FAILURE;
-	if(!crossCheckPatternHorizontal(ch[2], module_size_max, &centerx_b, centery_b, &module_size_bh))
+	if(!crossCheckPatternHorizontal(ch[2], NULL, module_size_max, &centerx_b, centery_b, &module_size_bh))
 		return JAB_FAILURE;
 	if(crossCheckPatternDiagonal(ch[2], fp->type, module_size_max, fp->center, &dir_b) < 0)
 		return JAB_FAILURE;
@@ -1058,17 +1125,209 @@ jab_int32 selectBestTwoColorPatterns(jab_finder_pattern* fps, jab_int32 fp_count
 	return missing_fp_count;
 }
 
+#define FP_SCAN_STRIPE_ROWS	64	//the number of scanned rows in a stripe of the parallel finder pattern search
+#define FP_SCAN_WAVE_STRIPES	4	//the number of stripes per thread scanned before the found candidates are merged
+
+/**
+ * @brief Finder pattern candidates found in a stripe of rows, in scan order
+*/
+typedef struct {
+    jab_finder_pattern* fps;
+    jab_int32 count;
+    jab_int32 capacity;
+}jab_fp_candidates;
+
+/**
+ * @brief The state of the parallel finder pattern search
+*/
+typedef struct {
+    jab_bitmap** ch;
+    jab_int32 row_step;             ///< the distance between the scanned rows
+    jab_int32 first_stripe;         ///< the first stripe of the current wave
+    jab_row_runs* runs;             ///< the run buffers of the three channels of each thread
+    jab_fp_candidates* stripes;     ///< the candidates of each stripe in the current wave
+    jab_boolean failed;             ///< set if a stripe ran out of memory
+}jab_fp_scan;
+
+/**
+ * @brief Append a finder pattern candidate to a candidate list
+ * @param candidates the candidate list
+ * @param fp the candidate
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_boolean addFinderPatternCandidate(jab_fp_candidates* candidates, jab_finder_pattern* fp)
+{
+    if(candidates->count == candidates->capacity)
+    {
+        jab_int32 capacity = candidates->capacity > 0 ? 2 * candidates->capacity : 16;
+        jab_finder_pattern* fps = (jab_finder_pattern*)realloc(candidates->fps, capacity * sizeof(jab_finder_pattern));
+        if(fps == NULL)
+            return JAB_FAILURE;
+        candidates->fps = fps;
+        candidates->capacity = capacity;
+    }
+    candidates->fps[candidates->count++] = *fp;
+    return JAB_SUCCESS;
+}
+
+/**
+ * @brief Find the finder pattern candidates in a row
+ * @param ch the binarized color channels of the image
+ * @param y the row index
+ * @param runs the run buffers for the red, green and blue row
+ * @param candidates the candidate list the cross-checked candidates are appended to
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_boolean scanRowForPatterns(jab_bitmap* ch[], jab_int32 y, jab_row_runs runs[3], jab_fp_candidates* candidates)
+{
+    //the red row is searched on its runs, the green and blue rows are converted when the first red candidate is found
+    const jab_byte* row_r = getBinaryRow(ch[0], y);
+    const jab_byte* row_g = getBinaryRow(ch[1], y);
+    const jab_byte* row_b = getBinaryRow(ch[2], y);
+    getRowRuns(row_r, ch[0]->width, &runs[0]);
+    runs[1].count = 0;
+    runs[2].count = 0;
+
+    jab_int32 startx = 0;
+    jab_int32 endx = ch[0]->width;
+    jab_int32 skip = 0;
+    jab_int32 type_r, type_g, type_b;
+    jab_float centerx_r, centerx_g, centerx_b;
+    jab_float module_size_r, module_size_g, module_size_b;
+
+    do
+    {
+        startx += skip;
+        endx = ch[0]->width;
+        //red channel
+        if(seekPattern(&runs[0], 0, &startx, &endx, &centerx_r, &module_size_r, &skip))
+        {
+            type_r = getRowPixel(row_r, (jab_int32)(centerx_r)) ? 255 : 0;
+            //green channel
+            if(runs[1].count == 0)
+                getRowRuns(row_g, ch[1]->width, &runs[1]);
+            centerx_g = centerx_r;
+            if(crossCheckPatternHorizontal(ch[1], &runs[1], module_size_r*2, &centerx_g, (jab_float)y, &module_size_g))
+            {
+                type_g = getRowPixel(row_g, (jab_int32)(centerx_g)) ? 255 : 0;
+                //blue channel
+                if(runs[2].count == 0)
+                    getRowRuns(row_b, ch[2]->width, &runs[2]);
+                centerx_b = centerx_r;
+                if(crossCheckPatternHorizontal(ch[2], &runs[2], module_size_r*2, &centerx_b, (jab_float)y, &module_size_b))
+                {
+                    type_b = getRowPixel(row_b, (jab_int32)(centerx_b)) ? 255 : 0;
+
+                    if(!checkModuleSize(module_size_r, module_size_g, module_size_b)) continue;
+
+                    jab_finder_pattern fp;
+                    fp.center.x = (centerx_r + centerx_g + centerx_b) / 3.0f;
+                    fp.center.y = (jab_float)y;
+                    fp.module_size = (module_size_r + module_size_g + module_size_b) / 3.0f;
+                    fp.found_count = 1;
+                    if( type_r == jab_default_palette[FP0_CORE_COLOR * 3]	  &&
+						type_g == jab_default_palette[FP0_CORE_COLOR * 3 + 1] &&
+						type_b == jab_default_palette[FP0_CORE_COLOR * 3 + 2])
+                    {
+                        fp.type = FP0;	//candidate for fp0
+                    }
+                    else if(type_r == jab_default_palette[FP1_CORE_COLOR * 3] &&
+							type_g == jab_default_palette[FP1_CORE_COLOR * 3 + 1] &&
+							type_b == jab_default_palette[FP1_CORE_COLOR * 3 + 2])
+                    {
+                        fp.type = FP1;	//candidate for fp1
+                    }
+                    else if(type_r == jab_default_palette[FP2_CORE_COLOR * 3] &&
+							type_g == jab_default_palette[FP2_CORE_COLOR * 3 + 1] &&
+							type_b == jab_default_palette[FP2_CORE_COLOR * 3 + 2])
+                    {
+                        fp.type = FP2;	//candidate for fp2
+                    }
+                    else if(type_r == jab_default_palette[FP3_CORE_COLOR * 3] &&
+							type_g == jab_default_palette[FP3_CORE_COLOR * 3 + 1] &&
+							type_b == jab_default_palette[FP3_CORE_COLOR * 3 + 2])
+                    {
+                        fp.type = FP3;	//candidate for fp3
+                    }
+                    else if(type_r == jab_default_palette[FP0_CORE_COLOR_BW * 3] &&
+							type_g == jab_default_palette[FP0_CORE_COLOR_BW * 3 + 1] &&
+							type_b == jab_default_palette[FP0_CORE_COLOR_BW * 3 + 2])
+                    {
+                        fp.type = FP0_BW;	//candidate for fp0 of black-white symbol
+                    }
+                    else if(type_r == jab_default_palette[FPX_CORE_COLOR_BW * 3] &&
+							type_g == jab_default_palette[FPX_CORE_COLOR_BW * 3 + 1] &&
+							type_b == jab_default_palette[FPX_CORE_COLOR_BW * 3 + 2])
+                    {
+                        fp.type = FPX_BW;	//candidate for fp1, fp2, fp3 of black-white symbol
+                    }
+                    else
+                    {
+                        fp.type = -1;
+                    }
+
+                    if(fp.type < 0) continue;
+
+                    if( crossCheckPattern(ch, &fp) )
+                    {
+                        if(!addFinderPatternCandidate(candidates, &fp))
+                            return JAB_FAILURE;
+                    }
+                }
+            }
+        }
+    }while(startx < ch[0]->width && endx < ch[0]->width);
+    return JAB_SUCCESS;
+}
+
+/**
+ * @brief Find the finder pattern candidates in a stripe of rows
+ * @param context the search state
+ * @param index the stripe index
+ * @param thread_index the index of the executing thread
+*/
+void scanStripeForPatterns(void* context, jab_int32 index, jab_int32 thread_index)
+{
+    jab_fp_scan* scan = (jab_fp_scan*)context;
+    jab_int32 begin = (scan->first_stripe + index) * FP_SCAN_STRIPE_ROWS * scan->row_step;
+    jab_int32 end = MIN(begin + FP_SCAN_STRIPE_ROWS * scan->row_step, scan->ch[0]->height);
+    for(jab_int32 y=begin; y<end; y+=scan->row_step)
+    {
+        if(!scanRowForPatterns(scan->ch, y, &scan->runs[thread_index * 3], &scan->stripes[index]))
+        {
+            __atomic_store_n(&scan->failed, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Get the distance between the rows scanned for finder patterns
+ * @param height the image height
+ * @param mode the detection mode
+ * @return the row distance
+*/
+jab_int32 getDetectRowStep(jab_int32 height, jab_detect_mode mode)
+{
+    //suppose the code size is minimally 1/4 image size, or 1/2 image size in quick mode
+    jab_int32 min_module_size = height / (2 * MAX_SYMBOL_ROWS * MAX_MODULES);
+    if(mode == QUICK_DETECT) min_module_size = height / (MAX_SYMBOL_ROWS * MAX_MODULES);
+    if(min_module_size < 1 || mode == INTENSIVE_DETECT) min_module_size = 1;
+    return min_module_size;
+}
+
 /**
  * @brief Find the master symbol in the image
+ * The rows are scanned in waves of parallel stripes. The candidates of a wave are merged in row order,
+ * so the result does not depend on the number of threads, and the scan stops when enough patterns are found.
  * @param ch the binarized color channels of the image
  * @param mode the detection mode
+ * @param deadline the time in microseconds after which the search is aborted, 0 for no limit
  * @return the finder pattern list | NULL
 */
-jab_finder_pattern* findMasterSymbol(jab_bitmap* ch[], jab_detect_mode mode)
+jab_finder_pattern* findMasterSymbol(jab_bitmap* ch[], jab_detect_mode mode, jab_uint64 deadline)
 {
-    //suppose the code size is minimally 1/4 image size
-    jab_int32 min_module_size = ch[0]->height / (2 * MAX_SYMBOL_ROWS * MAX_MODULES);
-    if(min_module_size < 1 || mode == INTENSIVE_DETECT) min_module_size = 1;
+    jab_int32 min_module_size = getDetectRowStep(ch[0]->height, mode);
 
     jab_finder_pattern* fps = (jab_finder_pattern*)calloc(MAX_FINDER_PATTERNS, sizeof(jab_finder_pattern));
     if(fps == NULL)
@@ -1076,106 +1335,74 @@ jab_finder_pattern* findMasterSymbol(jab_bitmap* ch[], jab_detect_mode mode)
         reportError("Memory allocation for finder patterns failed");
         return NULL;
     }
+    jab_fp_scan scan;
+    scan.ch = ch;
+    scan.row_step = min_module_size;
+    scan.failed = 0;
+    //the run buffers are per thread, so the thread number is read once for the buffers and the scan
+    jab_int32 threads = getThreadNumber();
+    jab_int32 wave_stripes = threads * FP_SCAN_WAVE_STRIPES;
+    scan.stripes = (jab_fp_candidates*)calloc(wave_stripes, sizeof(jab_fp_candidates));
+    scan.runs = (jab_row_runs*)malloc(threads * 3 * sizeof(jab_row_runs));
+    jab_int32* run_starts = (jab_int32*)malloc(threads * 3 * (ch[0]->width + 1) * sizeof(jab_int32));
+    if(scan.stripes == NULL || scan.runs == NULL || run_starts == NULL)
+    {
+        reportError("Memory allocation for finder pattern search failed");
+        free(scan.stripes);
+        free(scan.runs);
+        free(run_starts);
+        free(fps);
+        return NULL;
+    }
+    for(jab_int32 i=0; i<threads * 3; i++)
+        scan.runs[i].start = run_starts + i * (ch[0]->width + 1);
+
     jab_int32 total_finder_patterns = 0;
     jab_boolean done = 0;
     jab_int32 fp_type_count[6] = {0};
-
-    for(jab_int32 i=0; i<ch[0]->height && done == 0; i+=min_module_size)
+    jab_int32 stripe_number = ((ch[0]->height + min_module_size - 1) / min_module_size + FP_SCAN_STRIPE_ROWS - 1) / FP_SCAN_STRIPE_ROWS;
+    jab_boolean timeout = 0;
+    for(scan.first_stripe=0; scan.first_stripe<stripe_number && done == 0 && scan.failed == 0; scan.first_stripe+=wave_stripes)
     {
-        //get row
-        jab_byte* row_r = ch[0]->pixel + i*ch[0]->width;
-        jab_byte* row_g = ch[1]->pixel + i*ch[1]->width;
-        jab_byte* row_b = ch[2]->pixel + i*ch[2]->width;
-
-        jab_int32 startx = 0;
-        jab_int32 endx = ch[0]->width;
-        jab_int32 skip = 0;
-        jab_int32 type_r, type_g, type_b;
-        jab_float centerx_r, centerx_g, centerx_b;
-        jab_float module_size_r, module_size_g, module_size_b;
-
-        do
+        if(isDeadlinePassed(deadline))
         {
-            startx += skip;
-            endx = ch[0]->width;
-            //red channel
-            if(seekPattern(row_r, 0, &startx, &endx, &centerx_r, &module_size_r, &skip))
+            timeout = 1;
+            break;
+        }
+        jab_int32 count = MIN(wave_stripes, stripe_number - scan.first_stripe);
+        for(jab_int32 i=0; i<count; i++)
+            scan.stripes[i].count = 0;
+        runParallel(scanStripeForPatterns, &scan, count, threads);
+        //merge the candidates in row order
+        for(jab_int32 i=0; i<count && done == 0; i++)
+        {
+            for(jab_int32 k=0; k<scan.stripes[i].count; k++)
             {
-                type_r = row_r[(jab_int32)(centerx_r)] > 0 ? 255 : 0;
-                //green channel
-                centerx_g = centerx_r;
-                if(crossCheckPatternHorizontal(ch[1], module_size_r*2, &centerx_g, (jab_float)i, &module_size_g))
+                saveFinderPattern(&scan.stripes[i].fps[k], fps, &total_finder_patterns, fp_type_count);
+                if(total_finder_patterns >= (MAX_FINDER_PATTERNS -1) )
                 {
-                    type_g = row_g[(jab_int32)(centerx_g)] > 0 ? 255 : 0;
-                    //blue channel
-                    centerx_b = centerx_r;
-                    if(crossCheckPatternHorizontal(ch[2], module_size_r*2, &centerx_b, (jab_float)i, &module_size_b))
-                    {
-                        type_b = row_b[(jab_int32)(centerx_b)] > 0 ? 255 : 0;
-
-                        if(!checkModuleSize(module_size_r, module_size_g, module_size_b)) continue;
-
-                        jab_finder_pattern fp;
-                        fp.center.x = (centerx_r + centerx_g + centerx_b) / 3.0f;
-                        fp.center.y = (jab_float)i;
-                        fp.module_size = (module_size_r + module_size_g + module_size_b) / 3.0f;
-                        fp.found_count = 1;
-                        if( type_r == jab_default_palette[FP0_CORE_COLOR * 3]	  &&
-							type_g == jab_default_palette[FP0_CORE_COLOR * 3 + 1] &&
-							type_b == jab_default_palette[FP0_CORE_COLOR * 3 + 2])
-                        {
-                            fp.type = FP0;	//candidate for fp0
-                        }
-                        else if(type_r == jab_default_palette[FP1_CORE_COLOR * 3] &&
-								type_g == jab_default_palette[FP1_CORE_COLOR * 3 + 1] &&
-								type_b == jab_default_palette[FP1_CORE_COLOR * 3 + 2])
-                        {
-                            fp.type = FP1;	//candidate for fp1
-                        }
-                        else if(type_r == jab_default_palette[FP2_CORE_COLOR * 3] &&
-								type_g == jab_default_palette[FP2_CORE_COLOR * 3 + 1] &&
-								type_b == jab_default_palette[FP2_CORE_COLOR * 3 + 2])
-                        {
-                            fp.type = FP2;	//candidate for fp2
-                        }
-                        else if(type_r == jab_default_palette[FP3_CORE_COLOR * 3] &&
-								type_g == jab_default_palette[FP3_CORE_COLOR * 3 + 1] &&
-								type_b == jab_default_palette[FP3_CORE_COLOR * 3 + 2])
-                        {
-                            fp.type = FP3;	//candidate for fp3
-                        }
-                        else if(type_r == jab_default_palette[FP0_CORE_COLOR_BW * 3] &&
-								type_g == jab_default_palette[FP0_CORE_COLOR_BW * 3 + 1] &&
-								type_b == jab_default_palette[FP0_CORE_COLOR_BW * 3 + 2])
-                        {
-                            fp.type = FP0_BW;	//candidate for fp0 of black-white symbol
-                        }
-                        else if(type_r == jab_default_palette[FPX_CORE_COLOR_BW * 3] &&
-								type_g == jab_default_palette[FPX_CORE_COLOR_BW * 3 + 1] &&
-								type_b == jab_default_palette[FPX_CORE_COLOR_BW * 3 + 2])
-                        {
-                            fp.type = FPX_BW;	//candidate for fp1, fp2, fp3 of black-white symbol
-                        }
-                        else
-                        {
-                            fp.type = -1;
-                        }
-
-                        if(fp.type < 0) continue;
-
-                        if( crossCheckPattern(ch, &fp) )
-                        {
-                            saveFinderPattern(&fp, fps, &total_finder_patterns, fp_type_count);
-                            if(total_finder_patterns >= (MAX_FINDER_PATTERNS -1) )
-                            {
-                                done = 1;
-                                break;
-                            }
-                        }
-                    }
+                    done = 1;
+                    break;
                 }
             }
-        }while(startx < ch[0]->width && endx < ch[0]->width);
+        }
+    }
+    for(jab_int32 i=0; i<wave_stripes; i++)
+        free(scan.stripes[i].fps);
+    free(scan.stripes);
+    free(scan.runs);
+    free(run_starts);
+    if(scan.failed)
+    {
+        reportError("Memory allocation for finder pattern candidates failed");
+        free(fps);
+        return NULL;
+    }
+    if(timeout)
+    {
+        reportError("Finder pattern search aborted, time budget exceeded");
+        free(fps);
+        return NULL;
     }
 
 #if TEST_MODE
@@ -1297,6 +1524,45 @@ jab_finder_pattern* findMasterSymbol(jab_bitmap* ch[], jab_detect_mode mode)
     return fps;
 }
 
+#define PYRAMID_MAX_LEVELS		2		//the maximal number of downsampled levels, each one halves the resolution
+#define PYRAMID_MIN_MODULE_SIZE	2.0f	//the minimal module size of the finder patterns found in a downsampled level
+
+/**
+ * @brief Find the master symbol in downsampled channels and refine its finder patterns at full resolution
+ * The patterns are only used if their module size in the downsampled channels is at least PYRAMID_MIN_MODULE_SIZE.
+ * @param ch the binarized color channels of the image
+ * @param level_ch the binarized color channels downsampled by 2^level
+ * @param level the pyramid level
+ * @param deadline the time in microseconds after which the search is aborted, 0 for no limit
+ * @return the finder pattern list at full resolution | NULL if failed
+*/
+jab_finder_pattern* findMasterSymbolInLevel(jab_bitmap* ch[], jab_bitmap* level_ch[], jab_int32 level, jab_uint64 deadline)
+{
+    jab_finder_pattern* fps = findMasterSymbol(level_ch, INTENSIVE_DETECT, deadline);
+    if(fps == NULL)
+        return NULL;
+    if((fps[0].module_size + fps[1].module_size + fps[2].module_size + fps[3].module_size) / 4.0f < PYRAMID_MIN_MODULE_SIZE)
+    {
+        free(fps);
+        return NULL;
+    }
+    //refine the patterns at full resolution around the scaled positions
+    jab_float scale = (jab_float)(1 << level);
+    for(jab_int32 i=0; i<4; i++)
+    {
+        fps[i].center.x *= scale;
+        fps[i].center.y *= scale;
+        fps[i].module_size *= scale;
+        jab_finder_pattern fp = fps[i];
+        if(crossCheckPattern(ch, &fp))
+        {
+            fps[i].center = fp.center;
+            fps[i].module_size = fp.module_size;
+        }
+    }
+    return fps;
+}
+
 /**
  * @brief Get the side size of slave symbol by decoding its metadata
  * @param bitmap the image bitmap
@@ -1400,9 +1666,9 @@ jab_float crossCheckPatternDiagonalAP(jab_bitmap* image, jab_int32 ap_type, jab_
         jab_int32 starty = (jab_int32)center.y;
 
         state_count[1]++;
-        for(i=1, state_index=0; i<=starty && i<=startx && state_index<=1; i++)
+        for(i=1, state_index=0; (starty+i*offset_y)>=0 && (starty+i*offset_y)<image->height && (startx+i*offset_x)>=0 && (startx+i*offset_x)<image->width && state_index<=1; i++)
         {
-            if( image->pixel[(starty + i*offset_y)*image->width + (startx + i*offset_x)] == image->pixel[(starty + (i-1)*offset_y)*image->width + (startx + (i-1)*offset_x)] )
+            if( getBinaryPixel(image, startx + i*offset_x, starty + i*offset_y) == getBinaryPixel(image, startx + (i-1)*offset_x, starty + (i-1)*offset_y) )
             {
                 state_count[1 - state_index]++;
             }
@@ -1437,9 +1703,9 @@ jab_float crossCheckPatternDiagonalAP(jab_bitmap* image, jab_int32 ap_type, jab_
 
 		if(!flag)
 		{
-			for(i=1, state_index=0; (starty+i)<image->height && (startx+i)<image->width && state_index<=1; i++)
+			for(i=1, state_index=0; (starty-i*offset_y)>=0 && (starty-i*offset_y)<image->height && (startx-i*offset_x)>=0 && (startx-i*offset_x)<image->width && state_index<=1; i++)
 			{
-				if( image->pixel[(starty - i*offset_y)*image->width + (startx - i*offset_x)] == image->pixel[(starty - (i-1)*offset_y)*image->width + (startx - (i-1)*offset_x)] )
+				if( getBinaryPixel(image, startx - i*offset_x, starty - i*offset_y) == getBinaryPixel(image, startx - (i-1)*offset_x, starty - (i-1)*offset_y) )
 				{
 					state_count[1 + state_index]++;
 				}
@@ -1512,7 +1778,7 @@ jab_float crossCheckPatternVerticalAP(jab_bitmap* image, jab_point center, jab_i
     state_count[1]++;
     for(i=1, state_index=0; i<=centery && state_index<=1; i++)
     {
-        if( image->pixel[(centery-i)*image->width + centerx] == image->pixel[(centery-(i-1))*image->width + centerx] )
+        if( getBinaryPixel(image, centerx, centery-i) == getBinaryPixel(image, centerx, centery-(i-1)) )
         {
             state_count[1 - state_index]++;
         }
@@ -1538,7 +1804,7 @@ jab_float crossCheckPatternVerticalAP(jab_bitmap* image, jab_point center, jab_i
 
     for(i=1, state_index=0; (centery+i)<image->height && state_index<=1; i++)
     {
-        if( image->pixel[(centery+i)*image->width + centerx] == image->pixel[(centery+(i-1))*image->width + centerx] )
+        if( getBinaryPixel(image, centerx, centery+i) == getBinaryPixel(image, centerx, centery+(i-1)) )
         {
             state_count[1 + state_index]++;
         }
@@ -1574,7 +1840,7 @@ jab_float crossCheckPatternVerticalAP(jab_bitmap* image, jab_point center, jab_i
 
 /**
  * @brief Crosscheck the alignment pattern candidate in horizontal direction
- * @param row the bitmap row
+ * @param row the bit-packed bitmap row
  * @param channel the color channel
  * @param startx the start position
  * @param endx the end position
@@ -1584,7 +1850,7 @@ jab_float crossCheckPatternVerticalAP(jab_bitmap* image, jab_point center, jab_i
  * @param module_size the module size in horizontal direction
  * @return the x coordinate of the horizontal scanline center | -1 if failed
 */
-jab_float crossCheckPatternHorizontalAP(jab_byte* row, jab_int32 channel, jab_int32 startx, jab_int32 endx, jab_int32 centerx, jab_int32 ap_type, jab_float module_size_max, jab_float* module_size)
+jab_float crossCheckPatternHorizontalAP(const jab_byte* row, jab_int32 channel, jab_int32 startx, jab_int32 endx, jab_int32 centerx, jab_int32 ap_type, jab_float module_size_max, jab_float* module_size)
 {
     jab_int32 core_color = -1;
     switch(ap_type)
@@ -1605,62 +1871,18 @@ jab_float crossCheckPatternHorizontalAP(jab_byte* row, jab_int32 channel, jab_in
 			core_color = jab_default_palette[APX_CORE_COLOR * 3 + channel];
 			break;
     }
-    if(row[centerx] != core_color)
+    if((getRowPixel(row, centerx) ? 255 : 0) != core_color)
         return -1;
 
     jab_int32 state_count[3] = {0};
     jab_int32 i, state_index;
 
     state_count[1]++;
-    for(i=1, state_index=0; (centerx-i)>=startx && state_index<=1; i++)
-    {
-        if( row[centerx - i] == row[centerx - (i-1)] )
-        {
-            state_count[1 - state_index]++;
-        }
-        else
-        {
-            if(state_index > 0 && state_count[1 - state_index] < 3)
-            {
-                state_count[1 - (state_index-1)] += state_count[1 - state_index];
-                state_count[1 - state_index] = 0;
-                state_index--;
-                state_count[1 - state_index]++;
-            }
-            else
-            {
-                state_index++;
-                if(state_index > 1) break;
-                else state_count[1 - state_index]++;
-            }
-        }
-    }
+    state_index = scanRowLayers(row, centerx, startx, -1, state_count, 1, &i);
     if(state_index < 1)
         return -1;
 
-    for(i=1, state_index=0; (centerx+i)<=endx && state_index<=1; i++)
-    {
-        if( row[centerx + i] == row[centerx + (i-1)] )
-        {
-            state_count[1 + state_index]++;
-        }
-        else
-        {
-            if(state_index > 0 && state_count[1 + state_index] < 3)
-            {
-                state_count[1 + (state_index-1)] += state_count[1 + state_index];
-                state_count[1 + state_index] = 0;
-                state_index--;
-                state_count[1 + state_index]++;
-            }
-            else
-            {
-                state_index++;
-                if(state_index > 1) break;
-                else state_count[1 + state_index]++;
-            }
-        }
-    }
+    state_index = scanRowLayers(row, centerx, endx, 1, state_count, 1, &i);
     if(state_index < 1)
         return -1;
 
@@ -1692,9 +1914,9 @@ jab_float crossCheckPatternHorizontalAP(jab_byte* row, jab_int32 channel, jab_in
 jab_boolean crossCheckPatternAP(jab_bitmap* ch[], jab_int32 y, jab_int32 minx, jab_int32 maxx, jab_int32 cur_x, jab_int32 ap_type, jab_float max_module_size, jab_float* centerx, jab_float* centery, jab_float* module_size, jab_int32* dir)
 {
 	//get row
-	jab_byte* row_r = ch[0]->pixel + y*ch[0]->width;
-	jab_byte* row_g = ch[1]->pixel + y*ch[1]->width;
-	jab_byte* row_b = ch[2]->pixel + y*ch[2]->width;
+	const jab_byte* row_r = getBinaryRow(ch[0], y);
+	const jab_byte* row_g = getBinaryRow(ch[1], y);
+	const jab_byte* row_b = getBinaryRow(ch[2], y);
 
 	jab_float l_centerx[3] = {0.0f};
 	jab_float l_centery[3] = {0.0f};
@@ -1719,7 +1941,7 @@ jab_boolean crossCheckPatternAP(jab_bitmap* ch[], jab_int32 y, jab_int32 minx, j
 	l_centery[0] = crossCheckPatternVerticalAP(ch[0], center, max_module_size, &l_module_size_v[0]);
 	if(l_centery[0] < 0) return JAB_FAILURE;
 	//again horizontally
-	row_r = ch[0]->pixel + ((jab_int32)l_centery[0])*ch[0]->width;
+	row_r = getBinaryRow(ch[0], (jab_int32)l_centery[0]);
 	l_centerx[0] = crossCheckPatternHorizontalAP(row_r, 0, minx, maxx, center.x, ap_type, max_module_size, &l_module_size_h[0]);
 	if(l_centerx[0] < 0) return JAB_FAILURE;
 
@@ -1727,7 +1949,7 @@ jab_boolean crossCheckPatternAP(jab_bitmap* ch[], jab_int32 y, jab_int32 minx, j
 	l_centery[1] = crossCheckPatternVerticalAP(ch[1], center, max_module_size, &l_module_size_v[1]);
 	if(l_centery[1] < 0) return JAB_FAILURE;
 	//again horizontally
-	row_g = ch[1]->pixel + ((jab_int32)l_centery[1])*ch[1]->width;
+	row_g = getBinaryRow(ch[1], (jab_int32)l_centery[1]);
 	l_centerx[1] = crossCheckPatternHorizontalAP(row_g, 1, minx, maxx, center.x, ap_type, max_module_size, &l_module_size_h[1]);
 	if(l_centerx[1] < 0) return JAB_FAILURE;
 
@@ -1735,7 +1957,7 @@ jab_boolean crossCheckPatternAP(jab_bitmap* ch[], jab_int32 y, jab_int32 minx, j
 	l_centery[2] = crossCheckPatternVerticalAP(ch[2], center, max_module_size, &l_module_size_v[2]);
 	if(l_centery[2] < 0) return JAB_FAILURE;
 	//again horizontally
-	row_b = ch[2]->pixel + ((jab_int32)l_centery[2])*ch[2]->width;
+	row_b = getBinaryRow(ch[2], (jab_int32)l_centery[2]);
 	l_centerx[2] = crossCheckPatternHorizontalAP(row_b, 2, minx, maxx, center.x, ap_type, max_module_size, &l_module_size_h[2]);
 	if(l_centerx[2] < 0) return JAB_FAILURE;
 
@@ -1791,6 +2013,8 @@ jab_alignment_pattern findAlignmentPattern(jab_bitmap* ch[], jab_float x, jab_fl
 			break;
 	}
 
+    jab_int32 core_r = core_color_r > 0;
+
     //define search range
     jab_int32 radius = (jab_int32)(4 * module_size);
     jab_int32 radius_max = 4 * radius;
@@ -1822,7 +2046,7 @@ jab_alignment_pattern findAlignmentPattern(jab_bitmap* ch[], jab_float x, jab_fl
 				continue;
 
             //get r channel row
-            jab_byte* row_r = ch[0]->pixel + i*ch[0]->width;
+            const jab_byte* row_r = getBinaryRow(ch[0], i);
 
             jab_float ap_module_size, centerx, centery;
             jab_int32 ap_dir;
@@ -1835,42 +2059,32 @@ jab_alignment_pattern findAlignmentPattern(jab_bitmap* ch[], jab_float x, jab_fl
 			{
 				if(dir < 0)	//go to left
 				{
-					while(row_r[left_tmpx] != core_color_r && left_tmpx > startx)
-					{
-						left_tmpx--;
-					}
+					if(left_tmpx > startx && getRowPixel(row_r, left_tmpx) != core_r)
+						left_tmpx = skipRunLeft(row_r, left_tmpx, startx);
 					if(left_tmpx <= startx)
 					{
 						dir = -dir;
 						continue;
 					}
 					ap_found = crossCheckPatternAP(ch, i, startx, endx, left_tmpx, ap_type, module_size*2, &centerx, &centery, &ap_module_size, &ap_dir);
-					while(row_r[left_tmpx] == core_color_r && left_tmpx > startx)
-					{
-						left_tmpx--;
-					}
+					if(left_tmpx > startx && getRowPixel(row_r, left_tmpx) == core_r)
+						left_tmpx = skipRunLeft(row_r, left_tmpx, startx);
 					dir = -dir;
 				}
 				else //go to right
 				{
-					while(row_r[right_tmpx] == core_color_r && right_tmpx < endx)
-					{
-						right_tmpx++;
-					}
-					while(row_r[right_tmpx] != core_color_r && right_tmpx < endx)
-					{
-						right_tmpx++;
-					}
+					if(right_tmpx < endx && getRowPixel(row_r, right_tmpx) == core_r)
+						right_tmpx = findRunEnd(row_r, right_tmpx, endx);
+					if(right_tmpx < endx && getRowPixel(row_r, right_tmpx) != core_r)
+						right_tmpx = findRunEnd(row_r, right_tmpx, endx);
 					if(right_tmpx >= endx)
 					{
 						dir = -dir;
 						continue;
 					}
 					ap_found = crossCheckPatternAP(ch, i, startx, endx, right_tmpx, ap_type, module_size*2, &centerx, &centery, &ap_module_size, &ap_dir);
-					while(row_r[right_tmpx] == core_color_r && right_tmpx < endx)
-					{
-						right_tmpx++;
-					}
+					if(right_tmpx < endx && getRowPixel(row_r, right_tmpx) == core_r)
+						right_tmpx = findRunEnd(row_r, right_tmpx, endx);
 					dir = -dir;
 				}
 			}
@@ -2570,22 +2784,16 @@ jab_bitmap* sampleSymbolByAlignmentPattern(jab_bitmap* bitmap, jab_bitmap* ch[],
 }
 
 /**
- * @brief Detect and decode a master symbol
+ * @brief Sample and decode a master symbol at the found finder patterns
  * @param bitmap the image bitmap
  * @param ch the binarized color channels of the image
+ * @param fps the finder pattern list, it is freed
  * @param master_symbol the master symbol
+ * @param deadline the time in microseconds after which the decoding is aborted, 0 for no limit
  * @return JAB_SUCCESS | JAB_FAILURE
 */
-jab_boolean detectMaster(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbol* master_symbol)
+jab_boolean decodeMasterAtPatterns(jab_bitmap* bitmap, jab_bitmap* ch[], jab_finder_pattern* fps, jab_decoded_symbol* master_symbol, jab_uint64 deadline)
 {
-    //find master symbol
-    jab_finder_pattern* fps;
-    fps = findMasterSymbol(ch, INTENSIVE_DETECT);
-    if(fps == NULL)
-    {
-        return JAB_FAILURE;
-    }
-
 	//check if the code/symbol is mirrored
 	//TODO: is it necessary? Perspective transform will correct the mirroring, won't it?
 /*	jab_point fp01, fp03;
@@ -2640,7 +2848,7 @@ jab_boolean detectMaster(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbo
 	master_symbol->pattern_positions[3] = fps[3].center;
 
 	//decode master symbol
-	jab_int32 decode_result = decodeMaster(matrix, master_symbol);
+	jab_int32 decode_result = decodeMaster(matrix, master_symbol, deadline);
 	free(matrix);
 	if(decode_result == JAB_SUCCESS)
 	{
@@ -2665,7 +2873,7 @@ jab_boolean detectMaster(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbo
 #endif // TEST_MODE
 			return JAB_FAILURE;
 		}
-		decode_result = decodeMaster(matrix, master_symbol);
+		decode_result = decodeMaster(matrix, master_symbol, deadline);
 		free(matrix);
 		if(decode_result == JAB_SUCCESS)
 			return JAB_SUCCESS;
@@ -2674,6 +2882,71 @@ jab_boolean detectMaster(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbo
 	}
 }
 
+/**
+ * @brief Detect and decode a master symbol
+ * If pyramid levels are enabled, the finder patterns are searched in the coarsest level first.
+ * The next finer level, or the next denser row scan of the cascade policy, is tried if the symbol is not found or not decoded.
+ * @param bitmap the image bitmap
+ * @param ch the binarized color channels of the image
+ * @param master_symbol the master symbol
+ * @param options the decode options
+ * @param deadline the time in microseconds after which the detection is aborted, 0 for no limit
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_boolean detectMaster(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbol* master_symbol, jab_decode_options* options, jab_uint64 deadline)
+{
+    //build the downsampled levels, each from the next finer one
+    jab_bitmap* pyramid[PYRAMID_MAX_LEVELS + 1][3] = {{ch[0], ch[1], ch[2]}};
+    jab_int32 levels = 0;
+    while(levels < MIN(options->pyramid_levels, PYRAMID_MAX_LEVELS))
+    {
+        jab_int32 c = 0;
+        for(; c<3; c++)
+        {
+            pyramid[levels + 1][c] = downsampleBinary(pyramid[levels][c]);
+            if(pyramid[levels + 1][c] == NULL) break;
+        }
+        if(c < 3)
+        {
+            for(jab_int32 k=0; k<c; k++) free(pyramid[levels + 1][k]);
+            break;
+        }
+        levels++;
+    }
+
+    //try the coarsest level first and fall back to the finer ones
+    jab_boolean detected = JAB_FAILURE;
+    for(jab_int32 level=levels; level>=0 && !detected; level--)
+    {
+        //the cascade scans the full resolution with increasing row density, the downsampled levels are always scanned intensively
+        jab_detect_mode mode = level == 0 && options->detect_policy == DETECT_POLICY_CASCADE ? QUICK_DETECT : INTENSIVE_DETECT;
+        jab_int32 last_step = 0;
+        for(; mode<=INTENSIVE_DETECT && !detected && !isDeadlinePassed(deadline); mode++)
+        {
+            //skip the modes that scan the same rows as the previous one
+            jab_int32 step = getDetectRowStep(pyramid[level][0]->height, mode);
+            if(step == last_step) continue;
+            last_step = step;
+
+            jab_finder_pattern* fps = level > 0 ? findMasterSymbolInLevel(ch, pyramid[level], level, deadline) : findMasterSymbol(ch, mode, deadline);
+            if(fps == NULL)
+                continue;
+            detected = decodeMasterAtPatterns(bitmap, ch, fps, master_symbol, deadline);
+            if(!detected)
+            {
+                if(master_symbol->palette) free(master_symbol->palette);
+                if(master_symbol->data) free(master_symbol->data);
+                memset(master_symbol, 0, sizeof(jab_decoded_symbol));
+            }
+        }
+    }
+    for(jab_int32 level=1; level<=levels; level++)
+    {
+        for(jab_int32 c=0; c<3; c++) free(pyramid[level][c]);
+    }
+    return detected;
+}
+
 /**
  * @brief Detect a slave symbol
  * @param bitmap the image bitmap
@@ -2728,9 +3001,10 @@ jab_bitmap* detectSlave(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbol
  * @param symbols the symbol list
  * @param host_index the index number of the host symbol
  * @param total the number of symbols in the list
+ * @param deadline the time in microseconds after which the decoding is aborted, 0 for no limit
  * @return JAB_SUCCESS | JAB_FAILURE
 */
-jab_boolean decodeDockedSlaves(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbol* symbols, jab_int32 host_index, jab_int32* total)
+jab_boolean decodeDockedSlaves(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbol* symbols, jab_int32 host_index, jab_int32* total, jab_uint64 deadline)
 {
     jab_int32 docked_positions[4] = {0};
     docked_positions[0] = symbols[host_index].metadata.docked_position & 0x08;
@@ -2750,7 +3024,7 @@ jab_boolean decodeDockedSlaves(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded
                 JAB_REPORT_ERROR(("Detecting slave symbol %d failed", symbols[*total].index))
                 return JAB_FAILURE;
             }
-            if(decodeSlave(matrix, &symbols[*total]))
+            if(decodeSlave(matrix, &symbols[*total], deadline))
             {
                 (*total)++;
                 free(matrix);
@@ -2766,152 +3040,44 @@ jab_boolean decodeDockedSlaves(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded
 }
 
 /**
- * @brief Preprocess the image
- * @param bitmap the image bitmap
+ * @brief Decode a JAB Code
+ * @param bitmap the image bitmap, it is not modified
+ * @param mode the decoding mode(NORMAL_DECODE: only output completely decoded data when all symbols are correctly decoded
+ *								 COMPATIBLE_DECODE: also output partly decoded data even if some symbols are not correctly decoded
+ * @return the decoded data | NULL if failed
 */
-void preprocessImage(jab_bitmap* bitmap)
+jab_data* decodeJABCode(jab_bitmap* bitmap, jab_int32 mode)
 {
-    jab_int32 bytes_per_pixel = bitmap->bits_per_pixel / 8;
-    jab_int32 bytes_per_row = bitmap->width * bytes_per_pixel;
-
-    for(jab_int32 i=0; i<bitmap->height; i++)
-    {
-        for(jab_int32 j=0; j<bitmap->width; j++)
-        {
-            jab_byte r = bitmap->pixel[i*bytes_per_row + j*bytes_per_pixel];
-			jab_byte g = bitmap->pixel[i*bytes_per_row + j*bytes_per_pixel + 1];
-            jab_byte b = bitmap->pixel[i*bytes_per_row + j*bytes_per_pixel + 2];
-
-            //jab_float mean = (jab_float)(r + g + b)/3.0f;
-
-            jab_byte max = MAX(MAX(r, g), b);
-            jab_byte min = MIN(MIN(r, g), b);
-            jab_float h;
-
-            //enhance magenta
-            if(r == max)
-			{
-				if(g >= b)
-				{
-					h = (jab_float)(g - b) / (jab_float)(max - min) * 60.0f;
-				}
-				else if(g < b)
-				{
-					h = (jab_float)(g - b) / (jab_float)(max - min) * 60.0f + 360;
-				}
-				//set both magenta and red as magenta
-				if((h < 30) || (h > 270 && h < 360))
-				{
-					b = r;//MIN(b*1.5, 255);
-					bitmap->pixel[i*bytes_per_row + j*bytes_per_pixel + 2] = b;
-				}
-			}
-            /*
-            if(r == max && g == min)
-            {
-            	if((b-g) > (g/2))
-				{
-					b = MIN(b*1.5, 255);
-					bitmap->pixel[i*bytes_per_row + j*bytes_per_pixel + 2] = b;
-				}
-            }*/
-            //enhance green
-            /*if(g == max || b == max)
-			{
-				if(g == max)
-				{
-					h = (jab_float)(b - r) / (jab_float)(max - min) * 60.0f + 120;
-				}
-				else if(b == max)
-				{
-					h = (jab_float)(r - g) / (jab_float)(max - min) * 60.0f + 240;
-				}
-				//set both green and cyan as green
-				if(h > 90 && h < 210)
-				{
-					g = MAX(max, g) * 1.5;
-					bitmap->pixel[i*bytes_per_row + j*bytes_per_pixel + 1] = g;
-				}
-
-			}
-			*/
-            if(g == max)
-			{
-				if((g-r) > (r/2) && (g-b) > (b/2))
-				{
-					g = MIN(g*1.5, 255);
-					r = r/3;
-					bitmap->pixel[i*bytes_per_row + j*bytes_per_pixel + 0] = r;
-					bitmap->pixel[i*bytes_per_row + j*bytes_per_pixel + 1] = g;
-				}
-			}
-			//restrain blue in yellow modules
-			/*if((r == max && g >= b) || (g == max) )
-			{
-				if(r == max && g >= b)
-				{
-					h = (jab_float)(g - b) / (jab_float)(max - min) * 60.0f;
-				}
-				else if(g == max)
-				{
-					h = (jab_float)(b - r) / (jab_float)(max - min) * 60.0f + 120;
-				}
-				//restrain blue
-				if(h > 30 && h < 90)
-				{
-					b >>= 2;
-					bitmap->pixel[i*bytes_per_row + j*bytes_per_pixel + 2] = b;
-				}
-			}
-			//enhance blue
-			if(b == max)
-			{
-				h = (jab_float)(r - g) / (jab_float)(max - min) * 60.0f + 240;
-				if(h > 210 && h < 270)
-				{
-					b = MIN(b*1.5, 255);
-					bitmap->pixel[i*bytes_per_row + j*bytes_per_pixel + 2] = b;
-				}
-			}*/
-        }
-    }
-#if TEST_MODE
-    saveImage(bitmap, "new.png");
-#endif // TEST_MODE
+	return decodeJABCodeEx(bitmap, mode, NULL);
 }
 
 /**
- * @brief Decode a JAB Code
- * @param bitmap the image bitmap
+ * @brief Decode a JAB Code with decode options
+ * @param bitmap the image bitmap, it is not modified
  * @param mode the decoding mode(NORMAL_DECODE: only output completely decoded data when all symbols are correctly decoded
  *								 COMPATIBLE_DECODE: also output partly decoded data even if some symbols are not correctly decoded
+ * @param options the decode options | NULL for the defaults
  * @return the decoded data | NULL if failed
 */
-jab_data* decodeJABCode(jab_bitmap* bitmap, jab_int32 mode)
+jab_data* decodeJABCodeEx(jab_bitmap* bitmap, jab_int32 mode, jab_decode_options* options)
 {
-    //make a copy of the bitmap
-	jab_bitmap* bitmap_copy = (jab_bitmap *)malloc(sizeof(jab_bitmap) + bitmap->width * bitmap->height * bitmap->channel_count * (bitmap->bits_per_channel/8));
-	if(bitmap_copy == NULL)
+	jab_decode_options default_options = {BINARIZER_BLOCK, 0, 0, DETECT_POLICY_INTENSIVE, 0};
+	if(options == NULL)
+		options = &default_options;
+	//the time budget covers the whole decoding, it is checked between the binarization and detection steps and the LDPC sub-blocks
+	jab_uint64 deadline = options->time_budget > 0 ? getTimeMicroseconds() + (jab_uint64)options->time_budget * 1000 : 0;
+
+	//binarize r, g, b channels, the binarizers enhance the colors on the fly and leave the bitmap unchanged
+	jab_bitmap* ch[3];
+	jab_int32 binarized;
+	if(options->binarizer == BINARIZER_INTEGRAL)
+		binarized = binarizerIntegral(bitmap, ch, options->threshold_radius, deadline);
+	else
+		binarized = binarizerRGB(bitmap, ch, deadline);
+	if(!binarized)
 	{
-		reportError("Memory allocation for bitmap copy failed");
 		return NULL;
 	}
-    bitmap_copy->bits_per_channel = bitmap->bits_per_channel;
-    bitmap_copy->bits_per_pixel   = bitmap->bits_per_pixel;
-    bitmap_copy->channel_count	  = bitmap->channel_count;
-    bitmap_copy->height 		  = bitmap->height;
-    bitmap_copy->width			  = bitmap->width;
-    memcpy(bitmap_copy->pixel, bitmap->pixel, bitmap->width * bitmap->height * bitmap->channel_count * (bitmap->bits_per_channel/8));
-
-    //preprocess the bitmap
-    preprocessImage(bitmap_copy);
-
-	//binarize r, g, b channels
-	jab_bitmap* ch[3];
-    ch[0] = binarizer(bitmap_copy, 0);
-    ch[1] = binarizer(bitmap_copy, 1);
-    ch[2] = binarizer(bitmap_copy, 2);
-    free(bitmap_copy);
 
 #if TEST_MODE
     test_mode_bitmap = (jab_bitmap*)malloc(sizeof(jab_bitmap) + bitmap->width * bitmap->height * bitmap->channel_count * (bitmap->bits_per_channel/8));
@@ -2921,9 +3087,16 @@ jab_data* decodeJABCode(jab_bitmap* bitmap, jab_int32 mode)
     test_mode_bitmap->height 		  = bitmap->height;
     test_mode_bitmap->width			  = bitmap->width;
     memcpy(test_mode_bitmap->pixel, bitmap->pixel, bitmap->width * bitmap->height * bitmap->channel_count * (bitmap->bits_per_channel/8));
-    saveImage(ch[0], "br.png");
-    saveImage(ch[1], "bg.png");
-    saveImage(ch[2], "bb.png");
+    const jab_char* test_mode_names[3] = {"br.png", "bg.png", "bb.png"};
+    for(jab_int32 i=0; i<3; i++)
+    {
+        jab_bitmap* unpacked = unpackBinary(ch[i]);
+        if(unpacked)
+        {
+            saveImage(unpacked, (jab_char*)test_mode_names[i]);
+            free(unpacked);
+        }
+    }
 #endif
 
     jab_decoded_symbol symbols[MAX_SYMBOL_NUMBER];
@@ -2932,14 +3105,20 @@ jab_data* decodeJABCode(jab_bitmap* bitmap, jab_int32 mode)
     jab_boolean res=1;
 
     //detect and decode master symbol
-    if(detectMaster(bitmap, ch, &symbols[0]))
+    if(detectMaster(bitmap, ch, &symbols[0], options, deadline))
 		total++;
     //detect and decode docked slave symbols recursively
     if(total>0)
     {
         for(jab_int32 i=0; i<total && total<MAX_SYMBOL_NUMBER; i++)
         {
-            if(!decodeDockedSlaves(bitmap, ch, symbols, i, &total))
+            if(isDeadlinePassed(deadline))
+            {
+                reportError("Decoding aborted, time budget exceeded");
+                res = 0;
+                break;
+            }
+            if(!decodeDockedSlaves(bitmap, ch, symbols, i, &total, deadline))
             {
                 res = 0;
                 break;
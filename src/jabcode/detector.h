@@ -108,10 +108,65 @@ typedef struct {
 	jab_data* data;
 }jab_decoded_symbol;
 
+/**
+ * @brief Run-length representation of a binary bitmap row
+*/
+typedef struct {
+	jab_int32	count;			///< the number of runs of pixels with the same color
+	jab_int32*	start;			///< the first position of each run, start[count] is the row width
+	jab_int32	cursor;			///< the run found by the last lookup, where the next lookup starts
+}jab_row_runs;
+
+//binarized channels are bit-packed, with pixel x of a row in bit x%8 of byte x/8 and rows padded to 64-bit words
+#define BINARY_ROW_BYTES(width)	((((width) + 63) / 64) * 8)
+
+/**
+ * @brief Get a row of a bit-packed binary bitmap
+ * @param binary the binary bitmap
+ * @param y the row index
+ * @return the row
+*/
+static inline const jab_byte* getBinaryRow(jab_bitmap* binary, jab_int32 y)
+{
+	return binary->pixel + y * BINARY_ROW_BYTES(binary->width);
+}
+
+/**
+ * @brief Get a pixel of a bit-packed binary row
+ * @param row the row
+ * @param x the pixel position
+ * @return 1 for a bright pixel | 0 for a dark pixel
+*/
+static inline jab_int32 getRowPixel(const jab_byte* row, jab_int32 x)
+{
+	return (row[x >> 3] >> (x & 7)) & 1;
+}
+
+/**
+ * @brief Get a pixel of a bit-packed binary bitmap
+ * @param binary the binary bitmap
+ * @param x the x coordinate
+ * @param y the y coordinate
+ * @return 1 for a bright pixel | 0 for a dark pixel
+*/
+static inline jab_int32 getBinaryPixel(jab_bitmap* binary, jab_int32 x, jab_int32 y)
+{
+	return getRowPixel(getBinaryRow(binary, y), x);
+}
+
 
-extern jab_bitmap* binarizer(jab_bitmap* bitmap, jab_int32 channel);
+extern jab_int32 binarizerRGB(jab_bitmap* bitmap, jab_bitmap* rgb[3], jab_uint64 deadline);
+extern jab_int32 binarizerIntegral(jab_bitmap* bitmap, jab_bitmap* rgb[3], jab_int32 radius, jab_uint64 deadline);
 extern jab_bitmap* binarizerHist(jab_bitmap* bitmap, jab_int32 channel);
 extern jab_bitmap* binarizerHard(jab_bitmap* bitmap, jab_int32 channel, jab_int32 threshold);
+extern jab_bitmap* packBinary(jab_bitmap* binary);
+extern jab_bitmap* unpackBinary(jab_bitmap* binary);
+extern jab_bitmap* downsampleBinary(jab_bitmap* binary);
+extern jab_int32 findRunEnd(const jab_byte* row, jab_int32 x, jab_int32 end);
+extern jab_int32 findRunStart(const jab_byte* row, jab_int32 x, jab_int32 begin);
+extern jab_int32 countBinaryPixels(const jab_byte* row, jab_int32 begin, jab_int32 end);
+extern jab_int32 getRowRuns(const jab_byte* row, jab_int32 width, jab_row_runs* runs);
+extern jab_int32 findRunIndex(jab_row_runs* runs, jab_int32 x);
 extern jab_perspective_transform* getPerspectiveTransform(jab_point p0, jab_point p1,
 														  jab_point p2, jab_point p3,
 														  jab_vector2d side_size);
@@ -41,6 +41,19 @@
 #define NORMAL_DECODE		0
 #define COMPATIBLE_DECODE	1
 
+#define BINARIZER_BLOCK		0
+#define BINARIZER_INTEGRAL	1
+
+#define DETECT_POLICY_INTENSIVE	0
+#define DETECT_POLICY_CASCADE	1
+
+#define LDPC_DECODER_BP			0
+#define LDPC_DECODER_MIN_SUM	1
+#define LDPC_DECODER_LAYERED	2
+
+#define LDPC_HARD_DECODER_GDBF		0
+#define LDPC_HARD_DECODER_BIT_FLIP	1
+
 #define VERSION2SIZE(x)		(x * 4 + 17)
 #define MAX(a,b) 			({__typeof__ (a) _a = (a); __typeof__ (b) _b = (b); _a > _b ? _a : _b;})
 #define MIN(a,b) 			({__typeof__ (a) _a = (a); __typeof__ (b) _b = (b); _a < _b ? _a : _b;})
@@ -118,13 +131,31 @@ typedef struct {
 	jab_bitmap*		bitmap;
 }jab_encode;
 
+/**
+ * @brief Decode parameters
+*/
+typedef struct {
+	jab_int32		binarizer;				///< the binarization method, BINARIZER_BLOCK or BINARIZER_INTEGRAL
+	jab_int32		threshold_radius;		///< the radius of the local mean window of BINARIZER_INTEGRAL, 0 for the default
+	jab_int32		pyramid_levels;			///< the number of downsampled levels searched for the master symbol before the full resolution, 0 (default) to disable, at most 2
+	jab_int32		detect_policy;			///< DETECT_POLICY_INTENSIVE (default) scans every row, DETECT_POLICY_CASCADE starts with sparse rows and only scans denser ones if the master symbol is not found
+	jab_int32		time_budget;			///< the maximal decoding time in milliseconds, 0 (default) or negative for no limit
+}jab_decode_options;
+
 
 extern jab_encode* createEncode(jab_int32 color_number, jab_int32 symbol_number);
 extern void destroyEncode(jab_encode* enc);
 extern jab_boolean generateJABCode(jab_encode* enc, jab_data* data);
 extern jab_data* decodeJABCode(jab_bitmap* bitmap, jab_int32 mode);
+extern jab_data* decodeJABCodeEx(jab_bitmap* bitmap, jab_int32 mode, jab_decode_options* options);
 extern jab_boolean saveImage(jab_bitmap* bitmap, jab_char* filename);
 extern jab_bitmap* readImage(jab_char* filename);
 extern void reportError(jab_char* message);
+extern void getLDPCCacheStatistics(jab_uint64* hits, jab_uint64* misses);
+extern void clearLDPCCache(void);
+extern void setLDPCDecoder(jab_int32 decoder);
+extern void setLDPCHardDecoder(jab_int32 decoder);
+extern void setLDPCPhiApproximation(jab_boolean enable);
+extern void setThreadNumber(jab_int32 number);
 
 #endif
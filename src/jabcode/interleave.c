@@ -16,72 +16,184 @@
 #include "jabcode.h"
 #include "encoder.h"
 #include "pseudo_random.h"
+#include <pthread.h>
 
 #define INTERLEAVE_SEED 226759
+#define INTERLEAVE_CACHE_SIZE	8		//maximal number of permutations kept in the permutation cache
 
 /**
- * @brief In-place interleaving
- * @param data the input data to be interleaved
+ * @brief Interleaving permutation of one data length
 */
-void interleaveData(jab_data* data)
+typedef struct {
+    jab_int32	length;
+    jab_int32	ref_count;
+    jab_uint64	last_used;
+    jab_boolean	cached;				///< cached permutations are not freed on release
+    jab_int32	index[];			///< the interleaved data at position i is the input data at position index[i]
+}jab_permutation;
+
+static pthread_mutex_t permutation_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static jab_permutation* permutation_cache[INTERLEAVE_CACHE_SIZE];
+static jab_uint64 permutation_cache_clock = 0;
+
+/**
+ * @brief Create the interleaving permutation
+ * @param length the data length
+ * @return the permutation | NULL if failed (out of memory)
+*/
+static jab_permutation* createPermutation(jab_int32 length)
 {
-    setSeed(INTERLEAVE_SEED);
-    for (jab_int32 i=0; i<data->length; i++)
+    jab_permutation* permutation = (jab_permutation *)malloc(sizeof(jab_permutation) + length*sizeof(jab_int32));
+    if(permutation == NULL)
+    {
+        reportError("Memory allocation for interleaving permutation failed");
+        return NULL;
+    }
+    permutation->length = length;
+    permutation->ref_count = 1;
+    permutation->cached = 0;
+    for(jab_int32 i=0; i<length; i++)
+        permutation->index[i] = i;
+    //interleave index
+    jab_lcg64 generator;
+    setSeed(&generator, INTERLEAVE_SEED);
+    for(jab_int32 i=0; i<length; i++)
     {
-        jab_int32 pos = (jab_int32)( (jab_float)lcg64_temper() / (jab_float)UINT32_MAX * (data->length - i) );
-        jab_char  tmp = data->data[data->length - 1 -i];
-        data->data[data->length - 1 - i] = data->data[pos];
-        data->data[pos] = tmp;
+        jab_int32 pos = (jab_int32)( (jab_float)lcg64_temper(&generator) / (jab_float)UINT32_MAX * (length - i) );
+        jab_int32 tmp = permutation->index[length - 1 - i];
+        permutation->index[length - 1 -i] = permutation->index[pos];
+        permutation->index[pos] = tmp;
     }
+    return permutation;
 }
 
 /**
- * @brief In-place deinterleaving
- * @param data the first input data to be deinterleaved
- * @param p the second input data to be deinterleaved
+ * @brief Get the interleaving permutation from the permutation cache, or create and cache it
+ * @param length the data length
+ * @return the permutation, to be released with releasePermutation | NULL if failed
 */
-void deinterleaveData(jab_data* data, jab_float* p)
+static jab_permutation* getPermutation(jab_int32 length)
 {
-    jab_int32 * index = (jab_int32 *)malloc(data->length * sizeof(jab_int32));
-    if(index == NULL)
+    pthread_mutex_lock(&permutation_cache_mutex);
+    permutation_cache_clock++;
+    for(jab_int32 i=0; i<INTERLEAVE_CACHE_SIZE; i++)
     {
-        reportError("Memory allocation for index buffer in deinterleaver failed");
-        return;
+        jab_permutation* permutation = permutation_cache[i];
+        if(permutation && permutation->length == length)
+        {
+            permutation->ref_count++;
+            permutation->last_used = permutation_cache_clock;
+            pthread_mutex_unlock(&permutation_cache_mutex);
+            return permutation;
+        }
     }
-    for(jab_int32 i=0; i<data->length; i++)
+    pthread_mutex_unlock(&permutation_cache_mutex);
+
+    jab_permutation* permutation = createPermutation(length);
+    if(permutation == NULL)
+        return NULL;
+
+    pthread_mutex_lock(&permutation_cache_mutex);
+    //another thread may have cached the same permutation in the meantime
+    jab_int32 slot = -1;
+    for(jab_int32 i=0; i<INTERLEAVE_CACHE_SIZE; i++)
     {
-		index[i] = i;
+        jab_permutation* cached = permutation_cache[i];
+        if(cached && cached->length == length)
+        {
+            cached->ref_count++;
+            cached->last_used = permutation_cache_clock;
+            pthread_mutex_unlock(&permutation_cache_mutex);
+            free(permutation);
+            return cached;
+        }
+        //prefer a free slot, otherwise evict the least recently used permutation that is not in use
+        if(cached == NULL)
+        {
+            if(slot < 0 || permutation_cache[slot] != NULL)
+                slot = i;
+        }
+        else if(cached->ref_count == 0 && (slot < 0 || (permutation_cache[slot] != NULL && cached->last_used < permutation_cache[slot]->last_used)))
+            slot = i;
     }
-    //interleave index
-    setSeed(INTERLEAVE_SEED);
-    for(jab_int32 i=0; i<data->length; i++)
+    //if all cached permutations are in use, the new one is not cached and freed after use
+    if(slot >= 0)
     {
-		jab_int32 pos = (jab_int32)( (jab_float)lcg64_temper() / (jab_float)UINT32_MAX * (data->length - i) );
-		jab_int32 tmp = index[data->length - 1 - i];
-		index[data->length - 1 -i] = index[pos];
-		index[pos] = tmp;
+        if(permutation_cache[slot])
+            free(permutation_cache[slot]);
+        permutation->cached = 1;
+        permutation->last_used = permutation_cache_clock;
+        permutation_cache[slot] = permutation;
     }
-    //deinterleave data
+    pthread_mutex_unlock(&permutation_cache_mutex);
+    return permutation;
+}
+
+/**
+ * @brief Release a permutation obtained from getPermutation
+ * @param permutation the permutation
+*/
+static void releasePermutation(jab_permutation* permutation)
+{
+    pthread_mutex_lock(&permutation_cache_mutex);
+    permutation->ref_count--;
+    jab_boolean release = !permutation->cached && permutation->ref_count == 0;
+    pthread_mutex_unlock(&permutation_cache_mutex);
+    if(release)
+        free(permutation);
+}
+
+/**
+ * @brief In-place interleaving
+ * @param data the input data to be interleaved
+*/
+void interleaveData(jab_data* data)
+{
+    jab_permutation* permutation = getPermutation(data->length);
     jab_char* tmp_data = (jab_char *)malloc(data->length * sizeof(jab_char));
-    if(tmp_data == NULL)
+    if(permutation == NULL || tmp_data == NULL)
     {
-        reportError("Memory allocation for temporary buffer in deinterleaver failed");
+        reportError("Memory allocation for interleaving failed");
+        if(permutation) releasePermutation(permutation);
+        free(tmp_data);
         return;
     }
-    jab_float* tmp_p = (jab_float *)malloc(data->length * sizeof(jab_float));
+    //gather
+    memcpy(tmp_data, data->data, data->length);
+    for(jab_int32 i=0; i<data->length; i++)
+        data->data[i] = tmp_data[permutation->index[i]];
+    free(tmp_data);
+    releasePermutation(permutation);
+}
+
+/**
+ * @brief In-place deinterleaving
+ * @param data the first input data to be deinterleaved
+ * @param p the second input data to be deinterleaved
+*/
+void deinterleaveData(jab_data* data, jab_float* p)
+{
+    jab_permutation* permutation = getPermutation(data->length);
+    if(permutation == NULL)
+        return;
+    //one temporary buffer for both arrays, the floats first for their alignment
+    jab_float* tmp_p = (jab_float *)malloc(data->length * (sizeof(jab_float) + sizeof(jab_char)));
     if(tmp_p == NULL)
     {
         reportError("Memory allocation for temporary buffer in deinterleaver failed");
+        releasePermutation(permutation);
         return;
     }
-	memcpy(tmp_data, data->data, data->length);
-	memcpy(tmp_p, p, data->length * sizeof(jab_float));
-	for(jab_int32 i=0; i<data->length; i++)
+    jab_char* tmp_data = (jab_char *)(tmp_p + data->length);
+    memcpy(tmp_data, data->data, data->length);
+    memcpy(tmp_p, p, data->length * sizeof(jab_float));
+    //scatter
+    for(jab_int32 i=0; i<data->length; i++)
     {
-        data->data[index[i]] = tmp_data[i];
-        p[index[i]] = tmp_p[i];
+        jab_int32 index = permutation->index[i];
+        data->data[index] = tmp_data[i];
+        p[index] = tmp_p[i];
     }
-    free(tmp_data);
     free(tmp_p);
-    free(index);
+    releasePermutation(permutation);
 }
@@ -19,6 +19,13 @@
 #include <stdio.h>
 #include "detector.h"
 #include "pseudo_random.h"
+#include <pthread.h>
+#include "parallel.h"
+//JAB_GENERIC_KERNELS builds only the portable kernels, e.g. to compare them with the vector kernels
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(JAB_GENERIC_KERNELS)
+#include <immintrin.h>
+#define LDPC_X86_SIMD
+#endif
 
 /**
  * @brief Create matrix A for message data
@@ -62,13 +69,14 @@ jab_int32 *createMatrixA(jab_int32 wc, jab_int32 wr, jab_int32 capacity)
     }
     //Permutate the columns and fill the remaining matrix
     //generate matrixA by following Gallagers algorithm
-    setSeed(LPDC_MESSAGE_SEED);
+    jab_lcg64 generator;
+    setSeed(&generator, LPDC_MESSAGE_SEED);
     for (jab_int32 i=1; i<wc; i++)
     {
         jab_int32 off_index=i*(capacity/wr);
         for (jab_int32 j=0;j<capacity;j++)
         {
-            jab_int32 pos = (jab_int32)( (jab_float)lcg64_temper() / (jab_float)UINT32_MAX * (capacity - j) );
+            jab_int32 pos = (jab_int32)( (jab_float)lcg64_temper(&generator) / (jab_float)UINT32_MAX * (capacity - j) );
             for (jab_int32 k=0;k<capacity/wr;k++)
                 matrixA[(off_index+k)*offset+j/32] |= ((matrixA[(permutation[pos]/32+k*offset)] >> (31-permutation[pos]%32)) & 1) << (31-j%32);
             jab_int32  tmp = permutation[capacity - 1 -j];
@@ -80,6 +88,76 @@ jab_int32 *createMatrixA(jab_int32 wc, jab_int32 wr, jab_int32 capacity)
     return matrixA;
 }
 
+/**
+ * @brief XOR a row of 64-bit words into another row
+ * @param dst the destination row
+ * @param src the source row
+ * @param words the number of words
+*/
+static void xorRowGeneric(jab_uint64* dst, const jab_uint64* src, jab_int32 words)
+{
+    for (jab_int32 k=0;k<words;k++)
+        dst[k] ^= src[k];
+}
+
+#ifdef LDPC_X86_SIMD
+__attribute__((target("sse2")))
+static void xorRowSSE2(jab_uint64* dst, const jab_uint64* src, jab_int32 words)
+{
+    jab_int32 k=0;
+    for (;k+2<=words;k+=2)
+        _mm_storeu_si128((__m128i*)(dst+k), _mm_xor_si128(_mm_loadu_si128((const __m128i*)(dst+k)), _mm_loadu_si128((const __m128i*)(src+k))));
+    xorRowGeneric(dst+k, src+k, words-k);
+}
+
+__attribute__((target("avx2")))
+static void xorRowAVX2(jab_uint64* dst, const jab_uint64* src, jab_int32 words)
+{
+    jab_int32 k=0;
+    for (;k+4<=words;k+=4)
+        _mm256_storeu_si256((__m256i*)(dst+k), _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(dst+k)), _mm256_loadu_si256((const __m256i*)(src+k))));
+    _mm256_zeroupper();
+    xorRowGeneric(dst+k, src+k, words-k);
+}
+#endif
+
+static void (*xor_row_kernel)(jab_uint64*, const jab_uint64*, jab_int32) = NULL;
+
+/**
+ * @brief XOR a row of 64-bit words into another row, using the best kernel for the CPU
+ * @param dst the destination row
+ * @param src the source row
+ * @param words the number of words
+*/
+static void xorRow(jab_uint64* dst, const jab_uint64* src, jab_int32 words)
+{
+    void (*kernel)(jab_uint64*, const jab_uint64*, jab_int32) = __atomic_load_n(&xor_row_kernel, __ATOMIC_RELAXED);
+    if(kernel == NULL)
+    {
+        kernel = xorRowGeneric;
+#ifdef LDPC_X86_SIMD
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2"))
+            kernel = xorRowAVX2;
+        else if(__builtin_cpu_supports("sse2"))
+            kernel = xorRowSSE2;
+#endif
+        __atomic_store_n(&xor_row_kernel, kernel, __ATOMIC_RELAXED);
+    }
+    kernel(dst, src, words);
+}
+
+/**
+ * @brief Get a bit of a row of 64-bit words
+ * @param row the row
+ * @param column the bit index
+ * @return the bit
+*/
+static inline jab_int32 getRowBit(const jab_uint64* row, jab_int32 column)
+{
+    return (row[column/64] >> (63-column%64)) & 1;
+}
+
 /**
  * @brief Gauss Jordan elimination algorithm
  * @param matrixA the matrix
@@ -87,10 +165,9 @@ jab_int32 *createMatrixA(jab_int32 wc, jab_int32 wr, jab_int32 capacity)
  * @param wr the number of '1's in a row
  * @param capacity the number of columns of the matrix
  * @param matrix_rank the rank of the matrix
- * @param encode specifies if function is called by the encoder or decoder
  * @return 0: success | 1: fatal error (out of memory)
 */
-jab_int32 GaussJordan(jab_int32* matrixA, jab_int32 wc, jab_int32 wr, jab_int32 capacity, jab_int32* matrix_rank, jab_boolean encode)
+jab_int32 GaussJordan(jab_int32* matrixA, jab_int32 wc, jab_int32 wr, jab_int32 capacity, jab_int32* matrix_rank)
 {
     jab_int32 loop=0;
     jab_int32 nb_pcb;
@@ -107,13 +184,36 @@ jab_int32 GaussJordan(jab_int32* matrixA, jab_int32 wc, jab_int32 wr, jab_int32
         reportError("Memory allocation for matrix in LDPC failed");
         return 1;
     }
-    memcpy(matrixH,matrixA,offset*nb_pcb*sizeof(jab_int32));
+
+    //the elimination works on rows of 64-bit words, followed by the table of pivot row combinations
+    jab_int32 words=(capacity+63)/64;
+    jab_int32 table_bits=1;
+    while(table_bits<LDPC_M4RI_MAX_BITS && (1 << (table_bits+1)) <= nb_pcb/8)
+        table_bits++;
+    jab_uint64* rows=(jab_uint64 *)malloc((nb_pcb+(1 << table_bits))*words*sizeof(jab_uint64));
+    if(rows == NULL)
+    {
+        reportError("Memory allocation for matrix in LDPC failed");
+        free(matrixH);
+        return 1;
+    }
+    jab_uint64* table=rows+nb_pcb*words;
+    for (jab_int32 i=0;i<nb_pcb;i++)
+    {
+        for (jab_int32 k=0;k<words;k++)
+        {
+            jab_uint64 high=(jab_uint32)matrixA[i*offset+2*k];
+            jab_uint64 low=2*k+1<offset ? (jab_uint32)matrixA[i*offset+2*k+1] : 0;
+            rows[i*words+k]=(high << 32) | low;
+        }
+    }
 
     jab_int32* column_arrangement=(jab_int32 *)calloc(capacity, sizeof(jab_int32));
     if(column_arrangement == NULL)
     {
         reportError("Memory allocation for matrix in LDPC failed");
         free(matrixH);
+        free(rows);
         return 1;
     }
     jab_boolean* processed_column=(jab_boolean *)calloc(capacity, sizeof(jab_boolean));
@@ -121,6 +221,7 @@ jab_int32 GaussJordan(jab_int32* matrixA, jab_int32 wc, jab_int32 wr, jab_int32
     {
         reportError("Memory allocation for matrix in LDPC failed");
         free(matrixH);
+        free(rows);
         free(column_arrangement);
         return 1;
     }
@@ -129,6 +230,7 @@ jab_int32 GaussJordan(jab_int32* matrixA, jab_int32 wc, jab_int32 wr, jab_int32
     {
         reportError("Memory allocation for matrix in LDPC failed");
         free(matrixH);
+        free(rows);
         free(column_arrangement);
         free(processed_column);
         return 1;
@@ -138,6 +240,7 @@ jab_int32 GaussJordan(jab_int32* matrixA, jab_int32 wc, jab_int32 wr, jab_int32
     {
         reportError("Memory allocation for matrix in LDPC failed");
         free(matrixH);
+        free(rows);
         free(column_arrangement);
         free(processed_column);
         free(zero_lines_nb);
@@ -146,45 +249,80 @@ jab_int32 GaussJordan(jab_int32* matrixA, jab_int32 wc, jab_int32 wr, jab_int32
 
     jab_int32 zero_lines=0;
 
-    for (jab_int32 i=0; i<nb_pcb; i++)
-    {
-        jab_int32 pivot_column=capacity+1;
-        for (jab_int32 j=0; j<capacity; j++)
-        {
-            if((matrixH[(offset*32*i+j)/32] >> (31-(offset*32*i+j)%32)) & 1)
-            {
-                pivot_column=j;
-                break;
-            }
-        }
-        if(pivot_column < capacity)
+    //Method of the Four Russians: the rows are processed in batches. The pivots of a batch are searched
+    //row by row as before, eliminating them only inside the batch, which leaves the batch rows mutually
+    //reduced. All other rows are then cleared of the batch pivots with a single table lookup, which gives
+    //the same result as eliminating one pivot after another.
+    jab_int32 pivots[LDPC_M4RI_MAX_BITS];
+    jab_uint64* pivot_rows[LDPC_M4RI_MAX_BITS];
+    for (jab_int32 first=0; first<nb_pcb; first+=table_bits)
+    {
+        jab_int32 last=first+table_bits < nb_pcb ? first+table_bits : nb_pcb;
+        jab_int32 nb_pivots=0;
+        for (jab_int32 i=first; i<last; i++)
         {
-            processed_column[pivot_column]=1;
-            column_arrangement[pivot_column]=i;
-            if (pivot_column>=nb_pcb)
+            jab_uint64* row=rows+i*words;
+            jab_int32 pivot_column=capacity+1;
+            for (jab_int32 k=0; k<words; k++)
             {
-                swap_col[2*loop]=pivot_column;
-                loop++;
+                if(row[k])
+                {
+                    pivot_column=k*64+__builtin_clzll(row[k]);
+                    break;
+                }
             }
-
-            jab_int32 off_index=pivot_column/32;
-            jab_int32 off_index1=pivot_column%32;
-            for (jab_int32 j=0; j<nb_pcb; j++)
+            if(pivot_column < capacity)
             {
-                if (((matrixH[off_index+j*offset] >> (31-off_index1)) & 1) && j != i)
+                processed_column[pivot_column]=1;
+                column_arrangement[pivot_column]=i;
+                if (pivot_column>=nb_pcb)
+                {
+                    swap_col[2*loop]=pivot_column;
+                    loop++;
+                }
+                //subtract pivot row GF(2) inside the batch
+                for (jab_int32 j=first; j<last; j++)
                 {
-                    //subtract pivot row GF(2)
-                    for (jab_int32 k=0;k<offset;k++)
-                        matrixH[k+offset*j] ^= matrixH[k+offset*i];
+                    if (j != i && getRowBit(rows+j*words, pivot_column))
+                        xorRow(rows+j*words, row, words);
                 }
+                pivots[nb_pivots]=pivot_column;
+                pivot_rows[nb_pivots]=row;
+                nb_pivots++;
+            }
+            else //zero line
+            {
+                zero_lines_nb[zero_lines]=i;
+                zero_lines++;
             }
         }
-        else //zero line
+        if(nb_pivots == 0)
+            continue;
+
+        //table of all combinations of the pivot rows, entry c is the sum of the rows selected by the bits of c
+        memset(table, 0, words*sizeof(jab_uint64));
+        for (jab_int32 c=1; c<(1 << nb_pivots); c++)
+        {
+            memcpy(table+c*words, table+(c & (c-1))*words, words*sizeof(jab_uint64));
+            xorRow(table+c*words, pivot_rows[__builtin_ctz(c)], words);
+        }
+        //subtract the pivot rows GF(2) from the other rows
+        for (jab_int32 j=0; j<nb_pcb; j++)
         {
-            zero_lines_nb[zero_lines]=i;
-            zero_lines++;
+            if(j == first)
+            {
+                j=last-1;
+                continue;
+            }
+            jab_uint64* row=rows+j*words;
+            jab_int32 c=0;
+            for (jab_int32 b=0; b<nb_pivots; b++)
+                c |= getRowBit(row, pivots[b]) << b;
+            if(c)
+                xorRow(row, table+c*words, words);
         }
     }
+    free(rows);
 
     *matrix_rank=nb_pcb-zero_lines;
     jab_int32 loop2=0;
@@ -232,44 +370,23 @@ jab_int32 GaussJordan(jab_int32* matrixA, jab_int32 wc, jab_int32 wr, jab_int32
             loop1++;
         }
     }
-    //rearrange matrixH if encoder and store it in matrixA
-    //rearrange matrixA if decoder
-    if(encode)
-    {
-        for(jab_int32 i=0;i< nb_pcb;i++)
-            memcpy(matrixA+i*offset,matrixH+column_arrangement[i]*offset,offset*sizeof(jab_int32));
+    //rearrange the rows of matrixA and swap the pivot columns to the front, the encoder and decoder both
+    //use this form of the parity check matrix
+    for(jab_int32 i=0;i< nb_pcb;i++)
+        memcpy(matrixH+i*offset,matrixA+column_arrangement[i]*offset,offset*sizeof(jab_int32));
 
-        //swap columns
-        jab_int32 tmp=0;
-        for(jab_int32 i=0;i<loop;i++)
-        {
-            for (jab_int32 j=0;j<nb_pcb;j++)
-            {
-                tmp ^= (-((matrixA[swap_col[2*i]/32+j*offset] >> (31-swap_col[2*i]%32)) & 1) ^ tmp) & (1 << 0);
-                matrixA[swap_col[2*i]/32+j*offset]   ^= (-((matrixA[swap_col[2*i+1]/32+j*offset] >> (31-swap_col[2*i+1]%32)) & 1) ^ matrixA[swap_col[2*i]/32+j*offset]) & (1 << (31-swap_col[2*i]%32));
-                matrixA[swap_col[2*i+1]/32+offset*j] ^= (-((tmp >> 0) & 1) ^ matrixA[swap_col[2*i+1]/32+offset*j]) & (1 << (31-swap_col[2*i+1]%32));
-            }
-        }
-    }
-    else
+    //swap columns
+    jab_int32 tmp=0;
+    for(jab_int32 i=0;i<loop;i++)
     {
-    //    memcpy(matrixH,matrixA,offset*nb_pcb*sizeof(jab_int32));
-        for(jab_int32 i=0;i< nb_pcb;i++)
-            memcpy(matrixH+i*offset,matrixA+column_arrangement[i]*offset,offset*sizeof(jab_int32));
-
-        //swap columns
-        jab_int32 tmp=0;
-        for(jab_int32 i=0;i<loop;i++)
+        for (jab_int32 j=0;j<nb_pcb;j++)
         {
-            for (jab_int32 j=0;j<nb_pcb;j++)
-            {
-                tmp ^= (-((matrixH[swap_col[2*i]/32+j*offset] >> (31-swap_col[2*i]%32)) & 1) ^ tmp) & (1 << 0);
-                matrixH[swap_col[2*i]/32+j*offset]   ^= (-((matrixH[swap_col[2*i+1]/32+j*offset] >> (31-swap_col[2*i+1]%32)) & 1) ^ matrixH[swap_col[2*i]/32+j*offset]) & (1 << (31-swap_col[2*i]%32));
-                matrixH[swap_col[2*i+1]/32+offset*j] ^= (-((tmp >> 0) & 1) ^ matrixH[swap_col[2*i+1]/32+offset*j]) & (1 << (31-swap_col[2*i+1]%32));
-            }
+            tmp ^= (-((matrixH[swap_col[2*i]/32+j*offset] >> (31-swap_col[2*i]%32)) & 1) ^ tmp) & (1 << 0);
+            matrixH[swap_col[2*i]/32+j*offset]   ^= (-((matrixH[swap_col[2*i+1]/32+j*offset] >> (31-swap_col[2*i+1]%32)) & 1) ^ matrixH[swap_col[2*i]/32+j*offset]) & (1 << (31-swap_col[2*i]%32));
+            matrixH[swap_col[2*i+1]/32+offset*j] ^= (-((tmp >> 0) & 1) ^ matrixH[swap_col[2*i+1]/32+offset*j]) & (1 << (31-swap_col[2*i+1]%32));
         }
-        memcpy(matrixA,matrixH,offset*nb_pcb*sizeof(jab_int32));
     }
+    memcpy(matrixA,matrixH,offset*nb_pcb*sizeof(jab_int32));
 
     free(column_arrangement);
     free(processed_column);
@@ -305,7 +422,8 @@ jab_int32 *createMetadataMatrixA(jab_int32 wc, jab_int32 capacity)
     }
     for (jab_int32 i=0;i<capacity;i++)
         permutation[i]=i;
-    setSeed(LPDC_METADATA_SEED);
+    jab_lcg64 generator;
+    setSeed(&generator, LPDC_METADATA_SEED);
     jab_int32 nb_once=capacity*nb_pcb/(jab_float)wc+3;
     nb_once=nb_once/nb_pcb;
     //Fill matrix randomly
@@ -313,7 +431,7 @@ jab_int32 *createMetadataMatrixA(jab_int32 wc, jab_int32 capacity)
     {
         for (jab_int32 j=0; j< nb_once; j++)
         {
-            jab_int32 pos = (jab_int32)( (jab_float)lcg64_temper() / (jab_float)UINT32_MAX * (capacity-j) );
+            jab_int32 pos = (jab_int32)( (jab_float)lcg64_temper(&generator) / (jab_float)UINT32_MAX * (capacity-j) );
             matrixA[i*offset+permutation[pos]/32] |= 1 << (31-permutation[pos]%32);
             jab_int32  tmp = permutation[capacity - 1 -j];
             permutation[capacity - 1 -j] = permutation[pos];
@@ -325,263 +443,932 @@ jab_int32 *createMetadataMatrixA(jab_int32 wc, jab_int32 capacity)
 }
 
 /**
- * @brief Create the generator matrix to encode messages
- * @param matrixA the error correction matrix
- * @param capacity the number of columns of the matrix
- * @param Pn the number of net message bits
- * @return the generator matrix | NULL if failed (out of memory)
+ * @brief Create the Tanner graph of a parity check matrix
+ * @param matrix the parity check matrix
+ * @param length the number of columns of the matrix
+ * @param height the number of rows of the matrix
+ * @return the Tanner graph | NULL if failed (out of memory)
 */
-jab_int32 *createGeneratorMatrix(jab_int32* matrixA, jab_int32 capacity, jab_int32 Pn)
+jab_tanner_graph* createTannerGraph(jab_int32* matrix, jab_int32 length, jab_int32 height)
 {
-    jab_int32 effwidth=ceil(Pn/(jab_float)32)*32;
-    jab_int32 offset=ceil(Pn/(jab_float)32);
-    jab_int32 offset_cap=ceil(capacity/(jab_float)32);
-    //create G [I C]
-    //remember matrixA is now A = [I CT], now use it and create G=[CT
-                //                                                 I ]
-    jab_int32* G=(jab_int32 *)calloc(offset*capacity, sizeof(jab_int32));
-    if(G == NULL)
+    jab_int32 offset=ceil(length/(jab_float)32);
+    jab_int32 edge_number=0;
+    for (jab_int32 i=0;i<offset*height;i++)
+        edge_number+=__builtin_popcount((jab_uint32)matrix[i]);
+
+    jab_tanner_graph* graph=(jab_tanner_graph *)malloc(sizeof(jab_tanner_graph) + (height+1 + length+1 + 3*edge_number)*sizeof(jab_int32));
+    if(graph == NULL)
     {
-        reportError("Memory allocation for matrix in LDPC failed");
+        reportError("Memory allocation for Tanner graph in LDPC failed");
         return NULL;
     }
+    graph->height=height;
+    graph->length=length;
+    graph->edge_number=edge_number;
+    graph->row_start=graph->data;
+    graph->row_column=graph->row_start + height+1;
+    graph->column_start=graph->row_column + edge_number;
+    graph->column_edge=graph->column_start + length+1;
+    graph->column_row=graph->column_edge + edge_number;
 
-    //fill identity matrix
-    for (jab_int32 i=0; i< Pn; i++)
-        G[(capacity-Pn+i) * offset+i/32] |= 1 << (31-i%32);
-
-    //copy CT matrix from A to G
-    jab_int32 matrix_index=capacity-Pn;
-    jab_int32 loop=0;
-
-    for (jab_int32 i=0; i<(capacity-Pn)*effwidth; i++)
+    //check node adjacency, counting the degree of each variable node
+    memset(graph->column_start, 0, (length+1)*sizeof(jab_int32));
+    jab_int32 edge=0;
+    for (jab_int32 j=0;j<height;j++)
     {
-        if(matrix_index >= capacity)
+        graph->row_start[j]=edge;
+        for (jab_int32 i=0;i<length;i++)
         {
-            loop++;
-            matrix_index=capacity-Pn;
+            if((matrix[j*offset+i/32] >> (31-i%32)) & 1)
+            {
+                graph->row_column[edge++]=i;
+                graph->column_start[i+1]++;
+            }
         }
-        if(i % effwidth < Pn)
+    }
+    graph->row_start[height]=edge;
+    //variable node adjacency
+    for (jab_int32 i=0;i<length;i++)
+        graph->column_start[i+1]+=graph->column_start[i];
+    jab_int32* fill=(jab_int32 *)malloc(length*sizeof(jab_int32));
+    if(fill == NULL)
+    {
+        reportError("Memory allocation for Tanner graph in LDPC failed");
+        free(graph);
+        return NULL;
+    }
+    memcpy(fill, graph->column_start, length*sizeof(jab_int32));
+    for (jab_int32 j=0;j<height;j++)
+    {
+        for (jab_int32 e=graph->row_start[j];e<graph->row_start[j+1];e++)
         {
-            G[i/32] ^= (-((matrixA[matrix_index/32+offset_cap*loop] >> (31-matrix_index%32)) & 1) ^ G[i/32]) & (1 << (31-i%32));
-            matrix_index++;
+            jab_int32 k=fill[graph->row_column[e]]++;
+            graph->column_edge[k]=e;
+            graph->column_row[k]=j;
         }
     }
-    return G;
+    free(fill);
+    return graph;
 }
 
 /**
- * @brief LDPC encoding
- * @param data the data to be encoded
- * @param coderate_params the two code rate parameter wc and wr indicating how many '1' in a column (Wc) and how many '1' in a row of the parity check matrix
- * @param from_to the start and stop index of data to encode parts of the massage for several symbols
- * @param index the symbol count
- * @return the encoded data | NULL if failed
+ * @brief Create the approximate lower triangular encoder of a parity check matrix (Richardson-Urbanke)
+ * @param matrix the parity check matrix after Gauss Jordan elimination, its first matrix_rank columns are the parity bits
+ * @param capacity the number of columns of the matrix
+ * @param height the number of rows of the matrix
+ * @param matrix_rank the rank of the matrix
+ * @return the encoder, laid out as described in ldpc.h | NULL if failed
 */
-jab_data *encodeLDPC(jab_data* data, jab_int32* coderate_params, jab_int32* from_to, jab_int32 index)
+jab_int32 *createLDPCEncoder(jab_int32* matrix, jab_int32 capacity, jab_int32 height, jab_int32 matrix_rank)
 {
-    jab_int32 matrix_rank=0;
-    jab_int32 wc, wr, Pg, Pn;       //number of '1' in column //number of '1' in row //gross message length //number of parity check symbols //calculate required parameters
-    wc=coderate_params[2*index];
-    wr=coderate_params[2*index+1];
-    Pn=from_to[2*index+1]-from_to[2*index];
-    if(wr > 0)
+    jab_tanner_graph* graph=createTannerGraph(matrix, capacity, height);
+    if(graph == NULL)
+        return NULL;
+    jab_int32* buffer=(jab_int32 *)calloc(3*height + 5*matrix_rank, sizeof(jab_int32));
+    if(buffer == NULL)
     {
-        Pg=ceil((Pn*wr)/(jab_float)(wr-wc));
-        Pg = wr * (ceil(Pg / (jab_float)wr));
+        reportError("Memory allocation for LDPC encoder failed");
+        free(graph);
+        return NULL;
     }
-    else
-        Pg=Pn*2;
+    jab_int32* degree=buffer;                   //the number of unsolved parity columns of each row
+    jab_int32* used=degree+height;
+    jab_int32* queue=used+height;
+    jab_int32* solved=queue+height;
+    jab_int32* step_row=solved+matrix_rank;     //the rows in encoding order, followed by the rows of the gap system
+    jab_int32* step_column=step_row+matrix_rank;
+    jab_int32* gap_column=step_column+matrix_rank;
+    jab_int32* score=gap_column+matrix_rank;
 
-#if TEST_MODE
-	JAB_REPORT_INFO(("wc: %d, wr: %d\tPg: %d, Pn: %d", wc, wr, Pg, Pn))
-#endif // TEST_MODE
+    //greedy triangulation: a row with a single unsolved parity column solves it by back-substitution. If
+    //there is no such row, an unsolved column is moved to the gap system and is solved at encoding time.
+    jab_int32 queue_start=0, queue_end=0;
+    for (jab_int32 j=0;j<height;j++)
+    {
+        for (jab_int32 e=graph->row_start[j];e<graph->row_start[j+1] && graph->row_column[e]<matrix_rank;e++)
+            degree[j]++;
+        if(degree[j] == 1)
+            queue[queue_end++]=j;
+    }
+    jab_int32 steps=0, gap=0;
+    while(steps+gap < matrix_rank)
+    {
+        jab_int32 column=-1;
+        if(queue_start < queue_end)
+        {
+            jab_int32 row=queue[queue_start++];
+            if(used[row] || degree[row] != 1)
+                continue;
+            for (jab_int32 e=graph->row_start[row];column<0 && graph->row_column[e]<matrix_rank;e++)
+            {
+                if(!solved[graph->row_column[e]])
+                    column=graph->row_column[e];
+            }
+            used[row]=1;
+            step_row[steps]=row;
+            step_column[steps]=column;
+            steps++;
+        }
+        else
+        {
+            //move the column to the gap that occurs in most rows with the fewest unsolved columns
+            jab_int32 min_degree=0;
+            for (jab_int32 j=0;j<height;j++)
+            {
+                if(!used[j] && degree[j] > 0 && (min_degree == 0 || degree[j] < min_degree))
+                    min_degree=degree[j];
+            }
+            if(min_degree == 0)
+                break;
+            memset(score, 0, matrix_rank*sizeof(jab_int32));
+            for (jab_int32 j=0;j<height;j++)
+            {
+                if(used[j] || degree[j] != min_degree)
+                    continue;
+                for (jab_int32 e=graph->row_start[j];e<graph->row_start[j+1] && graph->row_column[e]<matrix_rank;e++)
+                {
+                    jab_int32 c=graph->row_column[e];
+                    if(!solved[c] && ++score[c] > (column < 0 ? 0 : score[column]))
+                        column=c;
+                }
+            }
+            gap_column[gap++]=column;
+        }
+        solved[column]=1;
+        for (jab_int32 k=graph->column_start[column];k<graph->column_start[column+1];k++)
+        {
+            jab_int32 r=graph->column_row[k];
+            if(--degree[r] == 1 && !used[r])
+                queue[queue_end++]=r;
+        }
+    }
 
-    //in order to speed up the ldpc encoding, sub blocks are established
-    jab_int32 nb_sub_blocks=0;
-    for(jab_int32 i=1;i<10000;i++)
+    //the unused rows give the gap system phi * x_gap = s, where s is their syndrome after back-substitution with x_gap = 0
+    jab_int32 unused_number=0;
+    for (jab_int32 j=0;j<height;j++)
     {
-        if(Pg / i < 2700)
+        if(!used[j])
+            queue[unused_number++]=j;
+    }
+    jab_int32 words=(gap+63)/64;
+    jab_uint64* phi=(jab_uint64 *)calloc((2*unused_number + 2*gap)*words + capacity, sizeof(jab_uint64));
+    if(steps+gap < matrix_rank || phi == NULL)
+    {
+        reportError(phi ? "LDPC encoder could not be triangulated" : "Memory allocation for LDPC encoder failed");
+        free(phi);
+        free(buffer);
+        free(graph);
+        return NULL;
+    }
+    jab_uint64* reduced=phi+unused_number*words;
+    jab_uint64* gap_matrix=reduced+unused_number*words;
+    jab_uint64* inverse=gap_matrix+gap*words;
+    jab_uint64* value=inverse+gap*words;
+    //the columns of phi are computed 64 at a time, one bit of value per gap column
+    for (jab_int32 k=0;k<words;k++)
+    {
+        memset(value, 0, capacity*sizeof(jab_uint64));
+        for (jab_int32 g=k*64;g<gap && g<(k+1)*64;g++)
+            value[gap_column[g]]=(jab_uint64)1 << (63-g%64);
+        for (jab_int32 s=0;s<steps;s++)
         {
-            nb_sub_blocks=i;
-            break;
+            jab_uint64 v=0;
+            for (jab_int32 e=graph->row_start[step_row[s]];e<graph->row_start[step_row[s]+1];e++)
+                v^=value[graph->row_column[e]];
+            value[step_column[s]]=v;
+        }
+        for (jab_int32 i=0;i<unused_number;i++)
+        {
+            jab_uint64 v=0;
+            for (jab_int32 e=graph->row_start[queue[i]];e<graph->row_start[queue[i]+1];e++)
+                v^=value[graph->row_column[e]];
+            phi[i*words+k]=v;
         }
     }
-    jab_int32 Pg_sub_block=0;
-    jab_int32 Pn_sub_block=0;
-    if(wr > 0)
+    //select gap rows of full rank by forward elimination and invert them
+    memcpy(reduced, phi, unused_number*words*sizeof(jab_uint64));
+    for (jab_int32 g=0;g<gap;g++)
     {
-        Pg_sub_block=((Pg / nb_sub_blocks) / wr) * wr;
-        Pn_sub_block=Pg_sub_block * (wr-wc) / wr;
+        jab_int32 pivot=-1;
+        for (jab_int32 i=0;i<unused_number && pivot<0;i++)
+        {
+            if(!used[queue[i]] && getRowBit(reduced+i*words, g))
+                pivot=i;
+        }
+        if(pivot < 0)
+        {
+            reportError("LDPC encoder gap system is singular");
+            free(phi);
+            free(buffer);
+            free(graph);
+            return NULL;
+        }
+        used[queue[pivot]]=1;
+        step_row[steps+g]=queue[pivot];
+        step_column[steps+g]=gap_column[g];
+        memcpy(gap_matrix+g*words, phi+pivot*words, words*sizeof(jab_uint64));
+        inverse[g*words+g/64]=(jab_uint64)1 << (63-g%64);
+        for (jab_int32 i=0;i<unused_number;i++)
+        {
+            if(!used[queue[i]] && getRowBit(reduced+i*words, g))
+                xorRow(reduced+i*words, reduced+pivot*words, words);
+        }
+    }
+    for (jab_int32 g=0;g<gap;g++)
+    {
+        jab_int32 pivot=g;
+        while(!getRowBit(gap_matrix+pivot*words, g))
+            pivot++;
+        for (jab_int32 k=0;k<words && pivot!=g;k++)
+        {
+            jab_uint64 tmp=gap_matrix[g*words+k];
+            gap_matrix[g*words+k]=gap_matrix[pivot*words+k];
+            gap_matrix[pivot*words+k]=tmp;
+            tmp=inverse[g*words+k];
+            inverse[g*words+k]=inverse[pivot*words+k];
+            inverse[pivot*words+k]=tmp;
+        }
+        for (jab_int32 i=0;i<gap;i++)
+        {
+            if(i != g && getRowBit(gap_matrix+i*words, g))
+            {
+                xorRow(gap_matrix+i*words, gap_matrix+g*words, words);
+                xorRow(inverse+i*words, inverse+g*words, words);
+            }
+        }
+    }
+
+    //store the used rows in encoding order
+    jab_int32 edge_number=0;
+    for (jab_int32 i=0;i<matrix_rank;i++)
+        edge_number+=graph->row_start[step_row[i]+1]-graph->row_start[step_row[i]];
+    jab_int32 gap_words=(gap+31)/32;
+    jab_int32* encoder=(jab_int32 *)malloc((2 + matrix_rank+1 + edge_number + matrix_rank + gap*gap_words)*sizeof(jab_int32));
+    if(encoder == NULL)
+    {
+        reportError("Memory allocation for LDPC encoder failed");
     }
     else
     {
-        Pg_sub_block=Pg;
-        Pn_sub_block=Pn;
+        encoder[0]=gap;
+        encoder[1]=edge_number;
+        jab_int32* row_start=encoder+2;
+        jab_int32* row_column=row_start+matrix_rank+1;
+        jab_int32 edge=0;
+        for (jab_int32 i=0;i<matrix_rank;i++)
+        {
+            row_start[i]=edge;
+            for (jab_int32 e=graph->row_start[step_row[i]];e<graph->row_start[step_row[i]+1];e++)
+                row_column[edge++]=graph->row_column[e];
+        }
+        row_start[matrix_rank]=edge;
+        memcpy(row_column+edge_number, step_column, matrix_rank*sizeof(jab_int32));
+        //the inverse is stored in 32-bit words
+        jab_int32* inverse_words=row_column+edge_number+matrix_rank;
+        for (jab_int32 g=0;g<gap;g++)
+        {
+            for (jab_int32 k=0;k<gap_words;k++)
+                inverse_words[g*gap_words+k]=(jab_int32)(inverse[g*words+k/2] >> (k%2 ? 0 : 32));
+        }
     }
-    jab_int32 encoding_iterations=nb_sub_blocks=Pg / Pg_sub_block;//nb_sub_blocks;
-    if(Pn_sub_block * nb_sub_blocks < Pn)
-        encoding_iterations--;
+    free(phi);
+    free(buffer);
+    free(graph);
+    return encoder;
+}
+
+//decoder settings, read by the decoding threads and changeable at any time, hence accessed atomically
+static jab_int32 ldpc_soft_decoder = LDPC_DECODER_BP;
+static jab_int32 ldpc_hard_decoder = LDPC_HARD_DECODER_GDBF;
+static jab_boolean ldpc_phi_approximation = LDPC_PHI_APPROXIMATION;
+
+static pthread_mutex_t ldpc_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static jab_ldpc_matrix* ldpc_cache[LDPC_CACHE_SIZE];
+static jab_uint64 ldpc_cache_clock = 0;
+static jab_uint64 ldpc_cache_hits = 0;
+static jab_uint64 ldpc_cache_misses = 0;
+
+/**
+ * @brief Free an LDPC matrix
+ * @param ldpc the LDPC matrix
+*/
+void freeLDPCMatrix(jab_ldpc_matrix* ldpc)
+{
+    if(ldpc->matrix) free(ldpc->matrix);
+    if(ldpc->encoder) free(ldpc->encoder);
+    if(ldpc->graph) free(ldpc->graph);
+    free(ldpc);
+}
+
+/**
+ * @brief Create the parity check matrix (decoder) or the sparse encoder (encoder)
+ * @param wc the number of '1's in a column
+ * @param wr the number of '1's in a row, 0 for metadata
+ * @param capacity the number of columns of the matrix
+ * @param encode specifies if the matrix is used by the encoder or decoder
+ * @return the LDPC matrix | NULL if failed
+*/
+jab_ldpc_matrix* createLDPCMatrix(jab_int32 wc, jab_int32 wr, jab_int32 capacity, jab_boolean encode)
+{
+    jab_ldpc_matrix* ldpc = (jab_ldpc_matrix *)calloc(1, sizeof(jab_ldpc_matrix));
+    if(ldpc == NULL)
+    {
+        reportError("Memory allocation for matrix in LDPC failed");
+        return NULL;
+    }
+    ldpc->wc = wc;
+    ldpc->wr = wr;
+    ldpc->capacity = capacity;
+    ldpc->encode = encode;
+    ldpc->height = wr<4 ? capacity/2 : capacity/wr*wc;
+
     jab_int32* matrixA;
-    //Matrix A
     if(wr > 0)
-        matrixA = createMatrixA(wc, wr, Pg_sub_block);
+        matrixA = createMatrixA(wc, wr, capacity);
     else
-        matrixA = createMetadataMatrixA(wc, Pg_sub_block);
+        matrixA = createMetadataMatrixA(wc, capacity);
     if(matrixA == NULL)
     {
-        reportError("Generator matrix could not be created in LDPC encoder.");
+        reportError("LDPC matrix could not be created.");
+        free(ldpc);
         return NULL;
     }
-    jab_boolean encode=1;
-    if(GaussJordan(matrixA, wc, wr, Pg_sub_block, &matrix_rank,encode))
+    if(GaussJordan(matrixA, wc, wr, capacity, &ldpc->matrix_rank))
     {
-        reportError("Gauss Jordan Elimination in LDPC encoder failed.");
+        reportError("Gauss Jordan Elimination in LDPC failed.");
         free(matrixA);
+        free(ldpc);
         return NULL;
     }
-    //Generator Matrix
-    jab_int32* G = createGeneratorMatrix(matrixA, Pg_sub_block, Pg_sub_block - matrix_rank);
-    if(G == NULL)
+    if(encode)
     {
-        reportError("Generator matrix could not be created in LDPC encoder.");
+        ldpc->encoder = createLDPCEncoder(matrixA, capacity, ldpc->height, ldpc->matrix_rank);
         free(matrixA);
-        return NULL;
-    }
-    free(matrixA);
-
-    jab_data* ecc_encoded_data = (jab_data *)malloc(sizeof(jab_data) + Pg*sizeof(jab_char));
-    if(ecc_encoded_data == NULL)
-    {
-        reportError("Memory allocation for LDPC encoded data failed");
-        free(G);
-        return NULL;
-    }
-
-    ecc_encoded_data->length = Pg;
-    jab_int32 temp,loop;
-    jab_int32 offset=ceil((Pg_sub_block - matrix_rank)/(jab_float)32);
-    //G * message = ecc_encoded_Data
-    for(jab_int32 iter=0; iter < encoding_iterations; iter++)
-    {
-        for (jab_int32 i=0;i<Pg_sub_block;i++)
+        if(ldpc->encoder == NULL)
         {
-            temp=0;
-            loop=0;
-            jab_int32 offset_index=offset*i;
-            for (jab_int32 j=from_to[2*index]+iter*Pn_sub_block; j < from_to[2*index]+(iter+1)*Pn_sub_block;j++)
-            {
-                temp ^= (((G[offset_index + loop/32] >> (31-loop%32)) & 1) & ((data->data[j] >> 0) & 1)) << 0;
-                loop++;
-            }
-            ecc_encoded_data->data[i+iter*Pg_sub_block]=(jab_char) ((temp >> 0) & 1);
+            reportError("Encoder could not be created in LDPC encoder.");
+            free(ldpc);
+            return NULL;
         }
     }
-    free(G);
-    if(encoding_iterations != nb_sub_blocks)
+    else
     {
-        jab_int32 start=from_to[2*index]+encoding_iterations*Pn_sub_block;
-        jab_int32 last_index=encoding_iterations*Pg_sub_block;
-        matrix_rank=0;
-        Pg_sub_block=Pg - encoding_iterations * Pg_sub_block;
-        Pn_sub_block=Pg_sub_block * (wr-wc) / wr;
-        jab_int32* matrixA = createMatrixA(wc, wr, Pg_sub_block);
-        if(matrixA == NULL)
+        ldpc->matrix = matrixA;
+        ldpc->graph = createTannerGraph(matrixA, capacity, ldpc->height);
+        if(ldpc->graph == NULL)
         {
-            reportError("Generator matrix could not be created in LDPC encoder.");
+            freeLDPCMatrix(ldpc);
             return NULL;
         }
-        if(GaussJordan(matrixA, wc, wr, Pg_sub_block, &matrix_rank,encode))
-        {
-            reportError("Gauss Jordan Elimination in LDPC encoder failed.");
-            free(matrixA);
-            return NULL;
-        }
-        jab_int32* G = createGeneratorMatrix(matrixA, Pg_sub_block, Pg_sub_block - matrix_rank);
-        if(G == NULL)
+    }
+    return ldpc;
+}
+
+#ifndef LDPC_TABLE_GENERATOR
+/**
+ * @brief Find a matrix in the precomputed LDPC matrix tables
+ * @param wc the number of '1's in a column
+ * @param wr the number of '1's in a row, 0 for metadata
+ * @param capacity the number of columns of the matrix
+ * @param encode specifies if the matrix is used by the encoder or decoder
+ * @return the precomputed matrix | NULL if not tabulated
+*/
+static jab_ldpc_matrix* findLDPCTable(jab_int32 wc, jab_int32 wr, jab_int32 capacity, jab_boolean encode)
+{
+    jab_int32 key[4] = {wc, wr, capacity, encode};
+    jab_int32 low = 0, high = ldpc_table_number - 1;
+    while(low <= high)
+    {
+        jab_int32 mid = (low + high) / 2;
+        jab_ldpc_matrix* entry = &ldpc_tables[mid];
+        jab_int32 entry_key[4] = {entry->wc, entry->wr, entry->capacity, entry->encode};
+        jab_int32 cmp = 0;
+        for(jab_int32 i=0; i<4 && cmp==0; i++)
+            cmp = (key[i] > entry_key[i]) - (key[i] < entry_key[i]);
+        if(cmp == 0)
+            return entry;
+        if(cmp < 0)
+            high = mid - 1;
+        else
+            low = mid + 1;
+    }
+    return NULL;
+}
+#endif
+
+/**
+ * @brief Find and reference a matrix in the LDPC matrix cache, the cache lock must be held
+ * @param wc the number of '1's in a column
+ * @param wr the number of '1's in a row, 0 for metadata
+ * @param capacity the number of columns of the matrix
+ * @param encode specifies if the matrix is used by the encoder or decoder
+ * @param free_slot the first free cache slot, -1 if the cache is full
+ * @return the cached matrix | NULL if not cached
+*/
+static jab_ldpc_matrix* findCachedLDPCMatrix(jab_int32 wc, jab_int32 wr, jab_int32 capacity, jab_boolean encode, jab_int32* free_slot)
+{
+    *free_slot = -1;
+    for(jab_int32 i=0; i<LDPC_CACHE_SIZE; i++)
+    {
+        jab_ldpc_matrix* ldpc = ldpc_cache[i];
+        if(ldpc == NULL)
         {
-            reportError("Generator matrix could not be created in LDPC encoder.");
-            free(matrixA);
-            return NULL;
+            if(*free_slot < 0) *free_slot = i;
+            continue;
         }
-        free(matrixA);
-        offset=ceil((Pg_sub_block - matrix_rank)/(jab_float)32);
-        for (jab_int32 i=0;i<Pg_sub_block;i++)
+        if(ldpc->wc == wc && ldpc->wr == wr && ldpc->capacity == capacity && ldpc->encode == encode)
         {
-            temp=0;
-            loop=0;
-            jab_int32 offset_index=offset*i;
-            for (jab_int32 j=start; j < from_to[2*index+1];j++)
-            {
-                temp ^= (((G[offset_index + loop/32] >> (31-loop%32)) & 1) & ((data->data[j] >> 0) & 1)) << 0;
-                loop++;
-            }
-            ecc_encoded_data->data[i+last_index]=(jab_char) ((temp >> 0) & 1);
+            ldpc->ref_count++;
+            ldpc->last_used = ldpc_cache_clock;
+            return ldpc;
         }
-        free(G);
     }
-    return ecc_encoded_data;
+    return NULL;
 }
 
 /**
- * @brief Iterative hard decision error correction decoder
- * @param data the received data
- * @param matrix the parity check matrix
- * @param length the encoded data length
- * @param height the number of check bits
- * @param max_iter the maximal number of iterations
- * @param is_correct indicating if decodedMessage function could correct all errors
- * @param start_pos indicating the position to start reading in data array
- * @return 1: error correction succeeded | 0: fatal error (out of memory)
+ * @brief Get an LDPC matrix from the precomputed tables or the matrix cache, create it if it is not cached yet
+ * @param wc the number of '1's in a column
+ * @param wr the number of '1's in a row, <=0 for metadata
+ * @param capacity the number of columns of the matrix
+ * @param encode specifies if the matrix is used by the encoder or decoder
+ * @return the LDPC matrix, to be returned by releaseLDPCMatrix | NULL if failed
 */
-jab_int32 decodeMessage(jab_byte* data, jab_int32* matrix, jab_int32 length, jab_int32 height, jab_int32 max_iter, jab_boolean *is_correct, jab_int32 start_pos)
+jab_ldpc_matrix* getLDPCMatrix(jab_int32 wc, jab_int32 wr, jab_int32 capacity, jab_boolean encode)
 {
-    jab_int32* max_val=(jab_int32 *)calloc(length, sizeof(jab_int32));
-    if(max_val == NULL)
+    if(wr < 0) wr = 0;
+    encode = encode ? 1 : 0;
+
+#ifndef LDPC_TABLE_GENERATOR
+    jab_ldpc_matrix* table_entry = findLDPCTable(wc, wr, capacity, encode);
+    if(table_entry)
     {
-        reportError("Memory allocation for LDPC decoder failed");
-        return 0;
+        pthread_mutex_lock(&ldpc_cache_mutex);
+        //the Tanner graphs of the precomputed matrices are built on first use
+        if(!encode && table_entry->graph == NULL)
+        {
+            table_entry->graph = createTannerGraph(table_entry->matrix, capacity, table_entry->height);
+            if(table_entry->graph == NULL)
+            {
+                pthread_mutex_unlock(&ldpc_cache_mutex);
+                return NULL;
+            }
+        }
+        table_entry->ref_count++;
+        ldpc_cache_hits++;
+        pthread_mutex_unlock(&ldpc_cache_mutex);
+        return table_entry;
     }
-    jab_int32* equal_max=(jab_int32 *)calloc(length, sizeof(jab_int32));
-    if(equal_max == NULL)
+#endif
+    pthread_mutex_lock(&ldpc_cache_mutex);
+    ldpc_cache_clock++;
+    jab_int32 free_slot;
+    jab_ldpc_matrix* cached = findCachedLDPCMatrix(wc, wr, capacity, encode, &free_slot);
+    if(cached)
+    {
+        ldpc_cache_hits++;
+        pthread_mutex_unlock(&ldpc_cache_mutex);
+        return cached;
+    }
+    ldpc_cache_misses++;
+    pthread_mutex_unlock(&ldpc_cache_mutex);
+
+    //the matrix generation is reentrant, so other threads can use the cache meanwhile
+    jab_ldpc_matrix* ldpc = createLDPCMatrix(wc, wr, capacity, encode);
+    if(ldpc == NULL)
+        return NULL;
+
+    pthread_mutex_lock(&ldpc_cache_mutex);
+    //another thread may have cached the same matrix in the meantime
+    cached = findCachedLDPCMatrix(wc, wr, capacity, encode, &free_slot);
+    if(cached)
     {
-        reportError("Memory allocation for LDPC decoder failed");
-        free(max_val);
-        return 0;
+        pthread_mutex_unlock(&ldpc_cache_mutex);
+        freeLDPCMatrix(ldpc);
+        return cached;
     }
-    jab_int32* prev_index=(jab_int32 *)calloc(length, sizeof(jab_int32));
-    if(prev_index == NULL)
+    ldpc->ref_count = 1;
+    ldpc->last_used = ldpc_cache_clock;
+    //evict the least recently used matrix that is not in use
+    if(free_slot < 0)
     {
-        reportError("Memory allocation for LDPC decoder failed");
-        free(max_val);
-        free(equal_max);
-        return 0;
+        for(jab_int32 i=0; i<LDPC_CACHE_SIZE; i++)
+        {
+            if(ldpc_cache[i]->ref_count == 0 && (free_slot < 0 || ldpc_cache[i]->last_used < ldpc_cache[free_slot]->last_used))
+                free_slot = i;
+        }
+        if(free_slot >= 0)
+        {
+            freeLDPCMatrix(ldpc_cache[free_slot]);
+            ldpc_cache[free_slot] = NULL;
+        }
+    }
+    //if all cached matrices are in use, the new one is not cached and freed after use
+    if(free_slot >= 0)
+    {
+        ldpc->cached = 1;
+        ldpc_cache[free_slot] = ldpc;
+    }
+    pthread_mutex_unlock(&ldpc_cache_mutex);
+    return ldpc;
+}
+
+/**
+ * @brief Return an LDPC matrix obtained by getLDPCMatrix
+ * @param ldpc the LDPC matrix
+*/
+void releaseLDPCMatrix(jab_ldpc_matrix* ldpc)
+{
+    if(ldpc == NULL) return;
+    pthread_mutex_lock(&ldpc_cache_mutex);
+    ldpc->ref_count--;
+    if(!ldpc->cached && ldpc->ref_count == 0)
+        freeLDPCMatrix(ldpc);
+    pthread_mutex_unlock(&ldpc_cache_mutex);
+}
+
+/**
+ * @brief Get the hit and miss counters of the LDPC matrix cache
+ * @param hits the number of cache hits
+ * @param misses the number of cache misses
+*/
+void getLDPCCacheStatistics(jab_uint64* hits, jab_uint64* misses)
+{
+    pthread_mutex_lock(&ldpc_cache_mutex);
+    if(hits)   *hits = ldpc_cache_hits;
+    if(misses) *misses = ldpc_cache_misses;
+    pthread_mutex_unlock(&ldpc_cache_mutex);
+}
+
+/**
+ * @brief Free all cached LDPC matrices that are not in use and reset the cache counters
+*/
+void clearLDPCCache(void)
+{
+    pthread_mutex_lock(&ldpc_cache_mutex);
+    for(jab_int32 i=0; i<LDPC_CACHE_SIZE; i++)
+    {
+        if(ldpc_cache[i] == NULL) continue;
+        if(ldpc_cache[i]->ref_count == 0)
+            freeLDPCMatrix(ldpc_cache[i]);
+        else
+            ldpc_cache[i]->cached = 0;		//freed by its last user
+        ldpc_cache[i] = NULL;
+    }
+    ldpc_cache_hits = 0;
+    ldpc_cache_misses = 0;
+    pthread_mutex_unlock(&ldpc_cache_mutex);
+}
+
+/**
+ * @brief Pack bits into 32-bit words in the bit order of the LDPC matrices
+ * @param bits the bits, one per byte
+ * @param length the number of bits
+ * @param words the packed bits, ceil(length/32) words
+*/
+void packBits(jab_byte* bits, jab_int32 length, jab_uint32* words)
+{
+    jab_int32 nb_words=ceil(length/(jab_float)32);
+    memset(words, 0, nb_words*sizeof(jab_uint32));
+    for (jab_int32 i=0;i<length;i++)
+        words[i/32] |= (jab_uint32)(bits[i] & 1) << (31-i%32);
+}
+
+/**
+ * @brief Parity of the bitwise product of a matrix row and a packed bit vector
+ * @param row the matrix row
+ * @param code the packed bit vector
+ * @param words the number of words to process
+ * @return the parity bit
+*/
+static jab_int32 parityGeneric(const jab_int32* row, const jab_uint32* code, jab_int32 words)
+{
+    jab_uint64 acc=0;
+    jab_int32 k=0;
+    for (;k+2<=words;k+=2)
+    {
+        jab_uint64 a, b;
+        memcpy(&a, row+k, sizeof(jab_uint64));
+        memcpy(&b, code+k, sizeof(jab_uint64));
+        acc ^= a & b;
+    }
+    if(k<words)
+        acc ^= (jab_uint32)row[k] & code[k];
+    return __builtin_parityll(acc);
+}
+
+#ifdef LDPC_X86_SIMD
+__attribute__((target("sse2")))
+static jab_int32 paritySSE2(const jab_int32* row, const jab_uint32* code, jab_int32 words)
+{
+    __m128i acc=_mm_setzero_si128();
+    jab_int32 k=0;
+    for (;k+4<=words;k+=4)
+        acc=_mm_xor_si128(acc, _mm_and_si128(_mm_loadu_si128((const __m128i*)(row+k)), _mm_loadu_si128((const __m128i*)(code+k))));
+    jab_uint64 lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    return __builtin_parityll(lanes[0] ^ lanes[1]) ^ parityGeneric(row+k, code+k, words-k);
+}
+
+__attribute__((target("avx2")))
+static jab_int32 parityAVX2(const jab_int32* row, const jab_uint32* code, jab_int32 words)
+{
+    __m256i acc=_mm256_setzero_si256();
+    jab_int32 k=0;
+    for (;k+8<=words;k+=8)
+        acc=_mm256_xor_si256(acc, _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(row+k)), _mm256_loadu_si256((const __m256i*)(code+k))));
+    jab_uint64 lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, acc);
+    _mm256_zeroupper();		//avoid AVX-SSE transition penalties in the following SSE code
+    return __builtin_parityll(lanes[0] ^ lanes[1] ^ lanes[2] ^ lanes[3]) ^ parityGeneric(row+k, code+k, words-k);
+}
+#endif
+
+static jab_int32 (*parity_kernel)(const jab_int32*, const jab_uint32*, jab_int32) = NULL;
+
+/**
+ * @brief Parity of the bitwise product of a matrix row and a packed bit vector, using the best kernel for the CPU
+ * @param row the matrix row
+ * @param code the packed bit vector
+ * @param words the number of words to process
+ * @return the parity bit
+*/
+jab_int32 rowParity(const jab_int32* row, const jab_uint32* code, jab_int32 words)
+{
+    jab_int32 (*kernel)(const jab_int32*, const jab_uint32*, jab_int32) = __atomic_load_n(&parity_kernel, __ATOMIC_RELAXED);
+    if(kernel == NULL)
+    {
+        kernel = parityGeneric;
+#ifdef LDPC_X86_SIMD
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2"))
+            kernel = parityAVX2;
+        else if(__builtin_cpu_supports("sse2"))
+            kernel = paritySSE2;
+#endif
+        __atomic_store_n(&parity_kernel, kernel, __ATOMIC_RELAXED);
+    }
+    return kernel(row, code, words);
+}
+
+/**
+ * @brief Check if the data satisfies the first rows of the parity check matrix
+ * @param matrix the parity check matrix
+ * @param length the data length
+ * @param height the number of rows to check
+ * @param data the data, one bit per byte
+ * @return 1: all checks satisfied | 0: otherwise
+*/
+jab_boolean isCodeword(jab_int32* matrix, jab_int32 length, jab_int32 height, jab_byte* data)
+{
+    jab_int32 offset=ceil(length/(jab_float)32);
+    jab_uint32 code[offset];
+    packBits(data, length, code);
+    for (jab_int32 i=0;i<height;i++)
+    {
+        if(rowParity(matrix+i*offset, code, offset))
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Get the parity of the codeword bits of a parity check row
+ * @param row_column the columns of the parity check rows
+ * @param start the first entry of the row
+ * @param end the end of the row
+ * @param codeword the codeword bits, one bit per byte
+ * @return the parity
+*/
+static inline jab_char getCodewordParity(const jab_int32* row_column, jab_int32 start, jab_int32 end, const jab_char* codeword)
+{
+    jab_char parity=0;
+    for (jab_int32 e=start;e<end;e++)
+        parity ^= codeword[row_column[e]];
+    return parity;
+}
+
+/**
+ * @brief Solve the parity bits of the encoder rows by back-substitution
+ * @param row_start the first entry of each row
+ * @param row_column the columns of the rows
+ * @param pivot_column the parity column solved by each row
+ * @param rows the number of rows
+ * @param codeword the codeword bits, one bit per byte
+*/
+static void solveEncoderRows(const jab_int32* row_start, const jab_int32* row_column, const jab_int32* pivot_column, jab_int32 rows, jab_char* codeword)
+{
+    for (jab_int32 i=0;i<rows;i++)
+        codeword[pivot_column[i]] ^= getCodewordParity(row_column, row_start[i], row_start[i+1], codeword);
+}
+
+/**
+ * @brief Encode one sub-block systematically
+ * @param ldpc the encoder matrix
+ * @param message the message bits, one bit per byte
+ * @param message_length the number of message bits, missing bits are encoded as '0'
+ * @param codeword the encoded sub-block of ldpc->capacity bits
+*/
+static void encodeSubBlock(jab_ldpc_matrix* ldpc, jab_char* message, jab_int32 message_length, jab_char* codeword)
+{
+    jab_int32 matrix_rank=ldpc->matrix_rank;
+    jab_int32 Pn=ldpc->capacity-matrix_rank;
+    if(message_length > Pn)
+        message_length=Pn;
+    const jab_int32* encoder=ldpc->encoder;
+    jab_int32 gap=encoder[0];
+    jab_int32 gap_words=(gap+31)/32;
+    const jab_int32* row_start=encoder+2;
+    const jab_int32* row_column=row_start+matrix_rank+1;
+    const jab_int32* pivot_column=row_column+encoder[1];
+    const jab_uint32* inverse=(const jab_uint32*)(pivot_column+matrix_rank);
+    jab_int32 steps=matrix_rank-gap;
+
+    //message bits
+    memset(codeword, 0, matrix_rank*sizeof(jab_char));
+    for (jab_int32 j=0;j<Pn;j++)
+        codeword[matrix_rank+j]=j<message_length ? (message[j] & 1) : 0;
+    //parity bits by back-substitution with the gap bits set to '0'
+    solveEncoderRows(row_start, row_column, pivot_column, steps, codeword);
+    if(gap == 0)
+        return;
+    //solve the gap bits from the syndrome of the gap rows and substitute again
+    jab_uint32 syndrome[gap_words];
+    memset(syndrome, 0, gap_words*sizeof(jab_uint32));
+    for (jab_int32 g=0;g<gap;g++)
+    {
+        if(getCodewordParity(row_column, row_start[steps+g], row_start[steps+g+1], codeword))
+            syndrome[g/32] |= 1 << (31-g%32);
+    }
+    for (jab_int32 g=0;g<gap;g++)
+    {
+        jab_int32 bit=0;
+        for (jab_int32 k=0;k<gap_words;k++)
+            bit^=__builtin_popcount(inverse[g*gap_words+k] & syndrome[k]);
+        codeword[pivot_column[steps+g]]=(jab_char)(bit & 1);
+    }
+    solveEncoderRows(row_start, row_column, pivot_column, steps, codeword);
+}
+
+/**
+ * @brief LDPC encoding
+ * @param data the data to be encoded
+ * @param coderate_params the two code rate parameter wc and wr indicating how many '1' in a column (Wc) and how many '1' in a row of the parity check matrix
+ * @param from_to the start and stop index of data to encode parts of the massage for several symbols
+ * @param index the symbol count
+ * @return the encoded data | NULL if failed
+*/
+jab_data *encodeLDPC(jab_data* data, jab_int32* coderate_params, jab_int32* from_to, jab_int32 index)
+{
+    jab_int32 wc, wr, Pg, Pn;       //number of '1' in column //number of '1' in row //gross message length //number of parity check symbols //calculate required parameters
+    wc=coderate_params[2*index];
+    wr=coderate_params[2*index+1];
+    Pn=from_to[2*index+1]-from_to[2*index];
+    if(wr > 0)
+    {
+        Pg=ceil((Pn*wr)/(jab_float)(wr-wc));
+        Pg = wr * (ceil(Pg / (jab_float)wr));
+    }
+    else
+        Pg=Pn*2;
+
+#if TEST_MODE
+	JAB_REPORT_INFO(("wc: %d, wr: %d\tPg: %d, Pn: %d", wc, wr, Pg, Pn))
+#endif // TEST_MODE
+
+    //in order to speed up the ldpc encoding, sub blocks are established
+    jab_int32 nb_sub_blocks=0;
+    for(jab_int32 i=1;i<10000;i++)
+    {
+        if(Pg / i < 2700)
+        {
+            nb_sub_blocks=i;
+            break;
+        }
+    }
+    jab_int32 Pg_sub_block=0;
+    jab_int32 Pn_sub_block=0;
+    if(wr > 0)
+    {
+        Pg_sub_block=((Pg / nb_sub_blocks) / wr) * wr;
+        Pn_sub_block=Pg_sub_block * (wr-wc) / wr;
     }
+    else
+    {
+        Pg_sub_block=Pg;
+        Pn_sub_block=Pn;
+    }
+    jab_int32 encoding_iterations=nb_sub_blocks=Pg / Pg_sub_block;//nb_sub_blocks;
+    if(Pn_sub_block * nb_sub_blocks < Pn)
+        encoding_iterations--;
+    //Parity matrix
+    jab_ldpc_matrix* ldpc = getLDPCMatrix(wc, wr, Pg_sub_block, 1);
+    if(ldpc == NULL)
+    {
+        reportError("Parity matrix could not be created in LDPC encoder.");
+        return NULL;
+    }
+
+    jab_data* ecc_encoded_data = (jab_data *)malloc(sizeof(jab_data) + Pg*sizeof(jab_char));
+    if(ecc_encoded_data == NULL)
+    {
+        reportError("Memory allocation for LDPC encoded data failed");
+        releaseLDPCMatrix(ldpc);
+        return NULL;
+    }
+
+    ecc_encoded_data->length = Pg;
+    for(jab_int32 iter=0; iter < encoding_iterations; iter++)
+        encodeSubBlock(ldpc, data->data+from_to[2*index]+iter*Pn_sub_block, Pn_sub_block, ecc_encoded_data->data+iter*Pg_sub_block);
+    releaseLDPCMatrix(ldpc);
+    if(encoding_iterations != nb_sub_blocks)
+    {
+        jab_int32 start=from_to[2*index]+encoding_iterations*Pn_sub_block;
+        jab_int32 last_index=encoding_iterations*Pg_sub_block;
+        Pg_sub_block=Pg - encoding_iterations * Pg_sub_block;
+        ldpc = getLDPCMatrix(wc, wr, Pg_sub_block, 1);
+        if(ldpc == NULL)
+        {
+            reportError("Parity matrix could not be created in LDPC encoder.");
+            free(ecc_encoded_data);
+            return NULL;
+        }
+        encodeSubBlock(ldpc, data->data+start, from_to[2*index+1] - start, ecc_encoded_data->data+last_index);
+        releaseLDPCMatrix(ldpc);
+    }
+    return ecc_encoded_data;
+}
+
+/**
+ * @brief Get the scratch memory of a decoder, the memory is enlarged if needed
+ * @param scratch the scratch memory
+ * @param size the required size in bytes
+ * @return the scratch memory, its content is undefined | NULL if failed (out of memory)
+*/
+static void* getLDPCScratch(jab_ldpc_scratch* scratch, jab_int32 size)
+{
+    if(size > scratch->size)
+    {
+        free(scratch->buffer);
+        scratch->buffer=malloc(size);
+        scratch->size=scratch->buffer ? size : 0;
+        if(scratch->buffer == NULL)
+        {
+            reportError("Memory allocation for LDPC decoder failed");
+            return NULL;
+        }
+    }
+    return scratch->buffer;
+}
+
+/**
+ * @brief Iterative hard decision error correction decoder
+ * @param data the received data
+ * @param matrix the parity check matrix
+ * @param length the encoded data length
+ * @param height the number of check bits
+ * @param max_iter the maximal number of iterations
+ * @param is_correct indicating if decodedMessage function could correct all errors
+ * @param start_pos indicating the position to start reading in data array
+ * @param scratch the decoder scratch memory of the executing thread
+ * @return 1: error correction succeeded | 0: fatal error (out of memory)
+*/
+jab_int32 decodeMessage(jab_byte* data, jab_int32* matrix, jab_int32 length, jab_int32 height, jab_int32 max_iter, jab_boolean *is_correct, jab_int32 start_pos, jab_ldpc_scratch* scratch)
+{
+    jab_int32* max_val=(jab_int32 *)getLDPCScratch(scratch, 3*length*sizeof(jab_int32));
+    if(max_val == NULL)
+        return 0;
+    jab_int32* equal_max=max_val+length;
+    jab_int32* prev_index=equal_max+length;
+    memset(max_val, 0, 3*length*sizeof(jab_int32));
 
     *is_correct=(jab_boolean)1;
     jab_int32 check=0;
     jab_int32 counter=0, prev_count=0;
     jab_int32 max=0;
     jab_int32 offset=ceil(length/(jab_float)32);
+    jab_uint32 code[offset];
+    packBits(data+start_pos, length, code);
+    jab_lcg64 generator;
+    setSeed(&generator, LDPC_FLIP_SEED + start_pos);
 
     for (jab_int32 kl=0;kl<max_iter;kl++)
     {
         max=0;
         for(jab_int32 j=0;j<height;j++)
         {
-            check=0;
-            for (jab_int32 i=0;i<length;i++)
-            {
-                if(((matrix[j*offset+i/32] >> (31-i%32)) & 1) & ((data[start_pos+i] >> 0) & 1))
-                    check+=1;
-            }
-            check=check%2;
+            check=rowParity(matrix+j*offset, code, offset);
             if(check)
             {
-                for(jab_int32 k=0;k<length;k++)
+                for(jab_int32 w=0;w<offset;w++)
                 {
-                    if(((matrix[j*offset+k/32] >> (31-k%32)) & 1))
-                        max_val[k]++;
+                    jab_uint32 bits=(jab_uint32)matrix[j*offset+w];
+                    while(bits)
+                    {
+                        jab_int32 b=__builtin_clz(bits);
+                        max_val[w*32+b]++;
+                        bits &= ~(0x80000000u >> b);
+                    }
                 }
             }
         }
@@ -611,9 +1398,10 @@ jab_int32 decodeMessage(jab_byte* data, jab_int32* matrix, jab_int32 length, jab
             *is_correct=(jab_boolean) 0;
             if(length < 36)
             {
-                jab_int32 rand_tmp=(jab_int32)(rand()/(jab_float)UINT32_MAX * counter);
+                jab_int32 rand_tmp=(jab_int32)((lcg64_temper(&generator) >> 1)/(jab_float)UINT32_MAX * counter);
                 prev_index[0]=start_pos+equal_max[rand_tmp];
                 data[start_pos+equal_max[rand_tmp]]=(data[start_pos+equal_max[rand_tmp]]+1)%2;
+                code[equal_max[rand_tmp]/32] ^= 0x80000000u >> (equal_max[rand_tmp]%32);
             }
             else
             {
@@ -621,6 +1409,7 @@ jab_int32 decodeMessage(jab_byte* data, jab_int32* matrix, jab_int32 length, jab
                 {
                     prev_index[j]=start_pos+equal_max[j];
                     data[start_pos+equal_max[j]]=(data[start_pos+equal_max[j]]+1)%2;
+                    code[equal_max[j]/32] ^= 0x80000000u >> (equal_max[j]%32);
                 }
             }
             prev_count=counter;
@@ -637,21 +1426,255 @@ jab_int32 decodeMessage(jab_byte* data, jab_int32* matrix, jab_int32 length, jab
 #if TEST_MODE
     JAB_REPORT_INFO(("start position:%d, stop position:%d, correct:%d", start_pos, start_pos+length,(jab_int32)*is_correct))
 #endif
-    free(prev_index);
-    free(equal_max);
-    free(max_val);
     return 1;
 }
 
+#define LDPC_BF_FLIPPED		1	//the bit differs from the received bit
+#define LDPC_BF_TABU		2	//the bit was flipped in the previous iteration
+
+/**
+ * @brief Iterative hard decision gradient descent bit flipping decoder with an incrementally updated syndrome
+ * @param data the received data
+ * @param graph the Tanner graph of the parity check matrix
+ * @param length the encoded data length
+ * @param checkbits the number of check bits
+ * @param max_iter the maximal number of iterations
+ * @param is_correct indicating if all parity checks are satisfied
+ * @param start_pos indicating the position to start reading in data array
+ * @param scratch the decoder scratch memory of the executing thread
+ * @return 1: error correction succeeded | 0: fatal error (out of memory)
+*/
+jab_int32 decodeMessageBF(jab_byte* data, jab_tanner_graph* graph, jab_int32 length, jab_int32 checkbits, jab_int32 max_iter, jab_boolean *is_correct, jab_int32 start_pos, jab_ldpc_scratch* scratch)
+{
+    //number of unsatisfied checks of each bit
+    jab_int32* unsatisfied=(jab_int32 *)getLDPCScratch(scratch, 3*length*sizeof(jab_int32) + length*sizeof(jab_byte));
+    if(unsatisfied == NULL)
+        return 0;
+    jab_int32* candidates=unsatisfied+length;
+    jab_byte* state=(jab_byte *)(candidates+2*length);
+    memset(unsatisfied, 0, length*sizeof(jab_int32));
+    memset(state, 0, length*sizeof(jab_byte));
+    //number of checks of each bit
+    jab_int32* degree=candidates+length;
+    for (jab_int32 i=0;i<length;i++)
+    {
+        degree[i]=0;
+        for (jab_int32 c=graph->column_start[i];c<graph->column_start[i+1] && graph->column_row[c]<checkbits;c++)
+            degree[i]++;
+    }
+    jab_byte* bits=data+start_pos;
+    jab_uint32 syndrome[(checkbits+31)/32+1];
+    memset(syndrome, 0, sizeof(syndrome));
+    jab_int32 unsatisfied_checks=0;
+    for (jab_int32 j=0;j<checkbits;j++)
+    {
+        jab_int32 parity=0;
+        for (jab_int32 e=graph->row_start[j];e<graph->row_start[j+1];e++)
+            parity ^= bits[graph->row_column[e]] & 1;
+        if(parity)
+        {
+            syndrome[j/32] |= 0x80000000u >> (j%32);
+            unsatisfied_checks++;
+            for (jab_int32 e=graph->row_start[j];e<graph->row_start[j+1];e++)
+                unsatisfied[graph->row_column[e]]++;
+        }
+    }
+    //deterministic and local to the sub-block, so that parallel decoding gives reproducible results
+    jab_lcg64 generator;
+    setSeed(&generator, LDPC_FLIP_SEED + start_pos);
+
+    for (jab_int32 kl=0;kl<max_iter && unsatisfied_checks>0;kl++)
+    {
+        //find the bits with the largest flip gain, skipping the bits flipped in the previous iteration
+        jab_int32 max=INT32_MIN, counter=0;
+        for (jab_int32 i=0;i<length;i++)
+        {
+            if(state[i] & LDPC_BF_TABU)
+            {
+                state[i] &= ~LDPC_BF_TABU;
+                continue;
+            }
+            if(unsatisfied[i] == 0)
+                continue;
+            //gradient descent bit flipping: unsatisfied minus satisfied checks, plus one if the bit
+            //was already flipped, as flipping it back restores the received bit
+            jab_int32 metric=2*unsatisfied[i]-degree[i]+((state[i] & LDPC_BF_FLIPPED) ? 1 : -1);
+            if(metric>max)
+            {
+                max=metric;
+                counter=0;
+            }
+            if(metric==max)
+                candidates[counter++]=i;
+        }
+        if(counter == 0)
+            break;
+        //short codes flip only one randomly chosen bit
+        if(length < 36)
+        {
+            candidates[0]=candidates[lcg64_temper(&generator) % counter];
+            counter=1;
+        }
+        //flip bits and update the syndrome and the unsatisfied check counters of the affected bits
+        for (jab_int32 k=0;k<counter;k++)
+        {
+            jab_int32 i=candidates[k];
+            bits[i] ^= 1;
+            state[i] ^= LDPC_BF_FLIPPED;
+            state[i] |= LDPC_BF_TABU;
+            for (jab_int32 c=graph->column_start[i];c<graph->column_start[i+1];c++)
+            {
+                jab_int32 j=graph->column_row[c];
+                if(j >= checkbits)
+                    break;
+                syndrome[j/32] ^= 0x80000000u >> (j%32);
+                jab_int32 delta=(syndrome[j/32] >> (31-j%32)) & 1 ? 1 : -1;
+                unsatisfied_checks+=delta;
+                for (jab_int32 e=graph->row_start[j];e<graph->row_start[j+1];e++)
+                    unsatisfied[graph->row_column[e]]+=delta;
+            }
+        }
+    }
+    *is_correct=(jab_boolean)(unsatisfied_checks == 0);
+#if TEST_MODE
+    JAB_REPORT_INFO(("start position:%d, stop position:%d, correct:%d", start_pos, start_pos+length,(jab_int32)*is_correct))
+#endif
+    return 1;
+}
+
+static jab_int32 decodeMessageSoft(jab_float* enc, jab_tanner_graph* graph, jab_int32 length, jab_int32 checkbits, jab_int32 max_iter, jab_boolean *is_correct, jab_int32 start_pos, jab_byte* dec, jab_ldpc_scratch* scratch);
+
+/**
+ * @brief Run the selected hard decision decoder
+ * @param data the received data
+ * @param ldpc the decoder matrix
+ * @param length the encoded data length
+ * @param max_iter the maximal number of iterations
+ * @param is_correct indicating if the decoder could correct all errors
+ * @param start_pos indicating the position to start reading in data array
+ * @param scratch the decoder scratch memory of the executing thread
+ * @return 1: success | 0: fatal error (out of memory)
+*/
+static jab_int32 decodeMessageHard(jab_byte* data, jab_ldpc_matrix* ldpc, jab_int32 length, jab_int32 max_iter, jab_boolean *is_correct, jab_int32 start_pos, jab_ldpc_scratch* scratch)
+{
+    if(__atomic_load_n(&ldpc_hard_decoder, __ATOMIC_RELAXED) == LDPC_HARD_DECODER_BIT_FLIP)
+        return decodeMessage(data, ldpc->matrix, length, ldpc->matrix_rank, max_iter, is_correct, start_pos, scratch);
+    return decodeMessageBF(data, ldpc->graph, length, ldpc->matrix_rank, max_iter*LDPC_GDBF_ITER_FACTOR, is_correct, start_pos, scratch);
+}
+
+/**
+ * @brief The sub-blocks of a message to be decoded
+*/
+typedef struct {
+	jab_byte*			data;			///< the hard decisions
+	jab_float*			enc;			///< the reliability values, NULL for hard decision decoding
+	jab_ldpc_matrix*	ldpc;			///< the matrix of the regular sub-blocks
+	jab_ldpc_matrix*	ldpc_last;		///< the matrix of the last sub-block, if its length differs
+	jab_int32			last_block;		///< the index of the last sub-block if its length differs, otherwise -1
+	jab_int32			block_length;
+	jab_int32			last_length;
+	jab_int32			max_iter;
+	jab_int32*			status;			///< 1: corrected | 0: too many errors | -1: fatal error | -2: time budget exceeded | 2: skipped
+	jab_ldpc_scratch*	scratch;		///< the decoder scratch memory of each thread
+	jab_uint64			deadline;		///< the time in microseconds after which the remaining sub-blocks fail, 0 for no limit
+	jab_boolean			failed;			///< set when a sub-block failed, the remaining sub-blocks are skipped
+}jab_ldpc_blocks;
+
+/**
+ * @brief Decode one sub-block
+ * @param context the sub-blocks
+ * @param index the sub-block index
+ * @param thread_index the index of the executing thread, selects the decoder scratch memory
+*/
+static void decodeSubBlock(void* context, jab_int32 index, jab_int32 thread_index)
+{
+    jab_ldpc_blocks* blocks = (jab_ldpc_blocks*)context;
+    jab_ldpc_matrix* ldpc = blocks->ldpc;
+    jab_int32 length = blocks->block_length;
+    if(index == blocks->last_block)
+    {
+        ldpc = blocks->ldpc_last;
+        length = blocks->last_length;
+    }
+    jab_int32 start_pos = index * blocks->block_length;
+    if(__atomic_load_n(&blocks->failed, __ATOMIC_RELAXED))
+    {
+        blocks->status[index] = 2;
+        return;
+    }
+    if(isDeadlinePassed(blocks->deadline))
+    {
+        blocks->status[index] = -2;
+        __atomic_store_n(&blocks->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    //first check syndrom
+    jab_boolean is_correct = isCodeword(ldpc->matrix, length, ldpc->matrix_rank, blocks->data+start_pos);
+    if(is_correct==0)
+    {
+        jab_int32 success;
+        if(blocks->enc)
+            success = decodeMessageSoft(blocks->enc, ldpc->graph, length, ldpc->matrix_rank, blocks->max_iter, &is_correct, start_pos, blocks->data, &blocks->scratch[thread_index]);
+        else
+            success = decodeMessageHard(blocks->data, ldpc, length, blocks->max_iter, &is_correct, start_pos, &blocks->scratch[thread_index]);
+        if(success == 0)
+        {
+            blocks->status[index] = -1;
+            __atomic_store_n(&blocks->failed, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        is_correct = isCodeword(ldpc->matrix, length, ldpc->matrix_rank, blocks->data+start_pos);
+    }
+    blocks->status[index] = is_correct;
+    if(!is_correct)
+        __atomic_store_n(&blocks->failed, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Decode all sub-blocks of a message, using the library threads
+ * @param blocks the sub-blocks
+ * @param nb_sub_blocks the number of sub-blocks
+ * @return 1: all sub-blocks corrected | 0: too many errors | -1: fatal error | -2: time budget exceeded
+*/
+static jab_int32 decodeSubBlocks(jab_ldpc_blocks* blocks, jab_int32 nb_sub_blocks)
+{
+    //the decoder buffers of each thread are reused for all sub-blocks it decodes
+    jab_int32 threads = getThreadNumber();
+    blocks->status = (jab_int32 *)malloc(nb_sub_blocks * sizeof(jab_int32));
+    blocks->scratch = (jab_ldpc_scratch *)calloc(threads, sizeof(jab_ldpc_scratch));
+    if(blocks->status == NULL || blocks->scratch == NULL)
+    {
+        reportError("Memory allocation for LDPC decoder failed");
+        free(blocks->status);
+        free(blocks->scratch);
+        return -1;
+    }
+    blocks->failed = 0;
+    runParallel(decodeSubBlock, blocks, nb_sub_blocks, threads);
+    //report the first failed sub-block, sub-blocks are only skipped after another one failed
+    jab_int32 result = 1;
+    for(jab_int32 i=0; i<nb_sub_blocks && result==1; i++)
+    {
+        if(blocks->status[i] != 2)
+            result = blocks->status[i];
+    }
+    for(jab_int32 i=0; i<threads; i++)
+        free(blocks->scratch[i].buffer);
+    free(blocks->scratch);
+    free(blocks->status);
+    return result;
+}
+
 /**
  * @brief LDPC decoding to perform hard decision
  * @param data the encoded data
  * @param length the encoded data length
  * @param wc the number of '1's in a column
  * @param wr the number of '1's in a row
+ * @param deadline the time in microseconds after which the decoding is aborted, 0 for no limit
  * @return the decoded data length | 0: fatal error (out of memory)
 */
-jab_int32 decodeLDPChd(jab_byte* data, jab_int32 length, jab_int32 wc, jab_int32 wr)
+jab_int32 decodeLDPChd(jab_byte* data, jab_int32 length, jab_int32 wc, jab_int32 wr, jab_uint64 deadline)
 {
     jab_int32 matrix_rank=0;
     jab_int32 max_iter=25;
@@ -697,145 +1720,59 @@ jab_int32 decodeLDPChd(jab_byte* data, jab_int32 length, jab_int32 wc, jab_int32
     if(Pn_sub_block * nb_sub_blocks < Pn)
         decoding_iterations--;
 
-    //parity check matrix
-    jab_int32* matrixA;
-    if(wr > 0)
-        matrixA = createMatrixA(wc, wr,Pg_sub_block);
-    else
-        matrixA = createMetadataMatrixA(wc, Pg_sub_block);
-    if(matrixA == NULL)
+    //parity check matrices of the regular and the last sub-block
+    jab_ldpc_blocks blocks;
+    blocks.data = data;
+    blocks.enc = NULL;
+    blocks.deadline = deadline;
+    blocks.block_length = Pg_sub_block;
+    blocks.max_iter = max_iter;
+    blocks.last_block = -1;
+    blocks.ldpc_last = NULL;
+    blocks.ldpc = getLDPCMatrix(wc, wr, Pg_sub_block, 0);
+    if(blocks.ldpc == NULL)
     {
         reportError("LDPC matrix could not be created in decoder.");
         return 0;
     }
-    jab_boolean encode=0;
-    if(GaussJordan(matrixA, wc, wr, Pg_sub_block, &matrix_rank,encode))
+    if(decoding_iterations != nb_sub_blocks)
     {
-        reportError("Gauss Jordan Elimination in LDPC encoder failed.");
-        free(matrixA);
+        blocks.last_block = decoding_iterations;
+        blocks.last_length = Pg - decoding_iterations * Pg_sub_block;
+        blocks.ldpc_last = getLDPCMatrix(wc, wr, blocks.last_length, 0);
+        if(blocks.ldpc_last == NULL)
+        {
+            reportError("LDPC matrix could not be created in decoder.");
+            releaseLDPCMatrix(blocks.ldpc);
+            return 0;
+        }
+    }
+    //the sub-blocks are independent, decode them (in parallel) before the message bits are gathered
+    jab_int32 result = decodeSubBlocks(&blocks, nb_sub_blocks);
+    if(result != 1)
+    {
+        if(result == -1)
+            reportError("LDPC decoder error.");
+        if(result == -2)
+            reportError("LDPC decoding aborted, time budget exceeded");
+        if(result == 0)
+            reportError("To many errors in message. LDPC decoding failed.");
+        releaseLDPCMatrix(blocks.ldpc_last);
+        releaseLDPCMatrix(blocks.ldpc);
         return 0;
     }
-
     jab_int32 old_Pg_sub=Pg_sub_block;
     jab_int32 old_Pn_sub=Pn_sub_block;
     for (jab_int32 iter = 0; iter < nb_sub_blocks; iter++)
     {
-        if(decoding_iterations != nb_sub_blocks && iter == decoding_iterations)
+        jab_ldpc_matrix* ldpc = blocks.ldpc;
+        if(iter == blocks.last_block)
         {
-            matrix_rank=0;
-            Pg_sub_block=Pg - decoding_iterations * Pg_sub_block;
+            ldpc = blocks.ldpc_last;
+            Pg_sub_block=blocks.last_length;
             Pn_sub_block=Pg_sub_block * (wr-wc) / wr;
-            jab_int32* matrixA1 = createMatrixA(wc, wr, Pg_sub_block);
-            if(matrixA1 == NULL)
-            {
-                reportError("LDPC matrix could not be created in decoder.");
-                return 0;
-            }
-            jab_boolean encode=0;
-            if(GaussJordan(matrixA1, wc, wr, Pg_sub_block, &matrix_rank,encode))
-            {
-                reportError("Gauss Jordan Elimination in LDPC encoder failed.");
-                free(matrixA1);
-                return 0;
-            }
-            //ldpc decoding
-            //first check syndrom
-            jab_boolean is_correct=1;
-            jab_int32 offset=ceil(Pg_sub_block/(jab_float)32);
-            for (jab_int32 i=0;i< matrix_rank; i++)
-            {
-                jab_int32 temp=0;
-                for (jab_int32 j=0;j<Pg_sub_block;j++)
-                    temp ^= (((matrixA1[i*offset+j/32] >> (31-j%32)) & 1) & ((data[iter*old_Pg_sub+j] >> 0) & 1)) << 0; //
-                if (temp)
-                {
-                    is_correct=(jab_boolean) 0;//message not correct
-                    break;
-                }
-            }
-
-            if(is_correct==0)
-            {
-                jab_int32 start_pos=iter*old_Pg_sub;
-                jab_int32 success=decodeMessage(data, matrixA1, Pg_sub_block, matrix_rank, max_iter, &is_correct,start_pos);
-                if(success == 0)
-                {
-                    reportError("LDPC decoder error.");
-                    free(matrixA1);
-                    return 0;
-                }
-            }
-            if(is_correct==0)
-            {
-                jab_boolean is_correct=1;
-                for (jab_int32 i=0;i< matrix_rank; i++)
-                {
-                    jab_int32 temp=0;
-                    for (jab_int32 j=0;j<Pg_sub_block;j++)
-                        temp ^= (((matrixA1[i*offset+j/32] >> (31-j%32)) & 1) & ((data[iter*old_Pg_sub+j] >> 0) & 1)) << 0;
-                    if (temp)
-                    {
-                        is_correct=(jab_boolean) 0;//message not correct
-                        break;
-                    }
-                }
-                if(is_correct==0)
-                {
-                    reportError("To many errors in message. LDPC decoding failed.");
-                    free(matrixA1);
-                    return 0;
-                }
-            }
-            free(matrixA1);
-        }
-        else
-        {
-            //ldpc decoding
-            //first check syndrom
-            jab_boolean is_correct=1;
-            jab_int32 offset=ceil(Pg_sub_block/(jab_float)32);
-            for (jab_int32 i=0;i< matrix_rank; i++)
-            {
-                jab_int32 temp=0;
-                for (jab_int32 j=0;j<Pg_sub_block;j++)
-                    temp ^= (((matrixA[i*offset+j/32] >> (31-j%32)) & 1) & ((data[iter*old_Pg_sub+j] >> 0) & 1)) << 0;
-                if (temp)
-                {
-                    is_correct=(jab_boolean) 0;//message not correct
-                    break;
-                }
-            }
-
-            if(is_correct==0)
-            {
-                jab_int32 start_pos=iter*old_Pg_sub;
-                jab_int32 success=decodeMessage(data, matrixA, Pg_sub_block, matrix_rank, max_iter, &is_correct, start_pos);
-                if(success == 0)
-                {
-                    reportError("LDPC decoder error.");
-                    free(matrixA);
-                    return 0;
-                }
-                is_correct=1;
-                for (jab_int32 i=0;i< matrix_rank; i++)
-                {
-                    jab_int32 temp=0;
-                    for (jab_int32 j=0;j<Pg_sub_block;j++)
-                        temp ^= (((matrixA[i*offset+j/32] >> (31-j%32)) & 1) & ((data[iter*old_Pg_sub+j] >> 0) & 1)) << 0;
-                    if (temp)
-                    {
-                        is_correct=(jab_boolean)0;//message not correct
-                        break;
-                    }
-                }
-                if(is_correct==0)
-                {
-                    reportError("To many errors in message. LDPC decoding failed.");
-                    free(matrixA);
-                    return 0;
-                }
-            }
         }
+        matrix_rank = ldpc->matrix_rank;
         jab_int32 loop=0;
         for (jab_int32 i=iter*old_Pg_sub;i < iter * old_Pg_sub + Pn_sub_block; i++)
         {
@@ -843,57 +1780,142 @@ jab_int32 decodeLDPChd(jab_byte* data, jab_int32 length, jab_int32 wc, jab_int32
             loop++;
         }
     }
-    free(matrixA);
-    return decoded_data_len;
+    releaseLDPCMatrix(blocks.ldpc_last);
+    releaseLDPCMatrix(blocks.ldpc);
+    return decoded_data_len;
+}
+
+//Gallager's function phi(x) = -log(tanh(x/2)) is tabulated at the points whose float representation
+//has the lowest 18 bits cleared, i.e. 32 points per octave from LDPC_PHI_MIN to LDPC_PHI_MAX,
+//and interpolated linearly in between. In this range the absolute error is below 1.4e-4 and the
+//relative error below 0.8%. Smaller arguments are clamped to LDPC_PHI_MIN, so that check node
+//messages saturate at 11.78.
+#define LDPC_PHI_MIN			(1.0f/65536)	//phi(LDPC_PHI_MIN) = 11.78 is the largest value returned
+#define LDPC_PHI_MAX			16.0f			//phi(x) < 2.3e-7 is returned as 0 above LDPC_PHI_MAX
+#define LDPC_PHI_SHIFT			18
+#define LDPC_PHI_TABLE_SIZE		(20*32+1)
+
+static jab_float ldpc_phi_value[LDPC_PHI_TABLE_SIZE];
+static jab_float ldpc_phi_slope[LDPC_PHI_TABLE_SIZE];
+static pthread_once_t ldpc_phi_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Get the grid point of the phi table
+ * @param index the table index
+ * @return the grid point
+*/
+static jab_float phiGridPoint(jab_int32 index)
+{
+    jab_float min = LDPC_PHI_MIN;
+    jab_uint32 bits;
+    memcpy(&bits, &min, sizeof(bits));
+    bits += (jab_uint32)index << LDPC_PHI_SHIFT;
+    jab_float x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+/**
+ * @brief Fill the phi table
+*/
+static void initPhiTable(void)
+{
+    for (jab_int32 i=0;i<LDPC_PHI_TABLE_SIZE;i++)
+    {
+        jab_double x0=phiGridPoint(i), x1=phiGridPoint(i+1);
+        jab_double y0=-log(tanh(x0*0.5)), y1=-log(tanh(x1*0.5));
+        ldpc_phi_value[i]=(jab_float)y0;
+        ldpc_phi_slope[i]=(jab_float)((y1-y0)/(x1-x0));
+    }
+}
+
+/**
+ * @brief Approximate Gallager's function phi(x) = -log(tanh(x/2)) by the phi table
+ * @param x the argument, x >= 0
+ * @return the approximated phi(x)
+*/
+static inline jab_float phi(jab_float x)
+{
+    if(x >= LDPC_PHI_MAX)
+        return 0.0f;
+    if(x < LDPC_PHI_MIN)
+        x = LDPC_PHI_MIN;
+    jab_uint32 bits, min_bits;
+    jab_float min = LDPC_PHI_MIN;
+    memcpy(&bits, &x, sizeof(bits));
+    memcpy(&min_bits, &min, sizeof(min_bits));
+    jab_int32 index=(bits-min_bits) >> LDPC_PHI_SHIFT;
+    bits &= ~(((jab_uint32)1 << LDPC_PHI_SHIFT) - 1);
+    jab_float x0;
+    memcpy(&x0, &bits, sizeof(x0));
+    return ldpc_phi_value[index] + ldpc_phi_slope[index]*(x-x0);
+}
+
+/**
+ * @brief Check node update in the phi domain, 2*atanh(prod(tanh(x/2))) = sign*phi(sum(phi(|x|)))
+ * @param input the input message of each edge of the check node
+ * @param output the output message of each edge of the check node
+ * @param degree the number of edges of the check node
+*/
+static void checkNodePhi(const jab_double* input, jab_double* output, jab_int32 degree)
+{
+    jab_float sum=0.0f;
+    jab_int32 sign=0;
+    for (jab_int32 i=0;i<degree;i++)
+    {
+        sum+=phi(fabs(input[i]));
+        sign^=input[i] < 0;
+    }
+    for (jab_int32 i=0;i<degree;i++)
+    {
+        jab_float magnitude=phi(fmaxf(sum-phi(fabs(input[i])), 0.0f));
+        output[i]=(sign ^ (input[i] < 0)) ? -magnitude : magnitude;
+    }
+}
+
+/**
+ * @brief Prepare the phi approximation for the check nodes of a Tanner graph
+ * @param graph the Tanner graph
+ * @return the largest check node degree, the size of the check node input buffer
+*/
+static jab_int32 preparePhiApproximation(jab_tanner_graph* graph)
+{
+    pthread_once(&ldpc_phi_once, initPhiTable);
+    jab_int32 max_degree=0;
+    for(jab_int32 j=0;j<graph->height;j++)
+    {
+        if(graph->row_start[j+1]-graph->row_start[j] > max_degree)
+            max_degree=graph->row_start[j+1]-graph->row_start[j];
+    }
+    return max_degree;
 }
 
 /**
  * @brief LDPC Iterative Log Likelihood decoding algorithm for binary codes
  * @param enc the received reliability value for each bit
- * @param matrix the error correction decoding matrix
+ * @param graph the Tanner graph of the error correction decoding matrix
  * @param length the encoded data length
  * @param checkbits the rank of the matrix
- * @param height the number of check bits
  * @param max_iter the maximal number of iterations
  * @param is_correct indicating if decodedMessage function could correct all errors
  * @param start_pos indicating the position to start reading in enc array
  * @param dec is the tentative decision after each decoding iteration
+ * @param scratch the decoder scratch memory of the executing thread
  * @return 1: success | 0: fatal error (out of memory)
 */
-jab_int32 decodeMessageILL(jab_float* enc, jab_int32* matrix, jab_int32 length, jab_int32 checkbits, jab_int32 height, jab_int32 max_iter, jab_boolean *is_correct, jab_int32 start_pos, jab_byte* dec)
+jab_int32 decodeMessageILL(jab_float* enc, jab_tanner_graph* graph, jab_int32 length, jab_int32 checkbits, jab_int32 max_iter, jab_boolean *is_correct, jab_int32 start_pos, jab_byte* dec, jab_ldpc_scratch* scratch)
 {
-    jab_double* lambda=(jab_double *)malloc(length * sizeof(jab_double));
+    jab_int32 height=graph->height;
+    jab_boolean phi_approximation=__atomic_load_n(&ldpc_phi_approximation, __ATOMIC_RELAXED);
+    jab_int32 max_degree=phi_approximation ? preparePhiApproximation(graph) : 0;
+    jab_double* lambda=(jab_double *)getLDPCScratch(scratch, (length + graph->edge_number + max_degree) * sizeof(jab_double));
     if(lambda == NULL)
-    {
-        reportError("Memory allocation for Lambda in LDPC decoder failed");
-        return 0;
-    }
-    jab_double* old_nu_row=(jab_double *)malloc(length * sizeof(jab_double));
-    if(old_nu_row == NULL)
-    {
-        reportError("Memory allocation for Lambda in LDPC decoder failed");
-        free(lambda);
-        return 0;
-    }
-    jab_double* nu=(jab_double *)malloc(length*height * sizeof(jab_double));
-    if(nu == NULL)
-    {
-        reportError("Memory allocation for nu in LDPC decoder failed");
-        free(old_nu_row);
-        free(lambda);
-        return 0;
-    }
-    memset(nu,0,length*height *sizeof(jab_double));
-    jab_int32* index=(jab_int32 *)malloc(length * sizeof(jab_int32));
-    if(index == NULL)
-    {
-        reportError("Memory allocation for index in LDPC decoder failed");
-        free(old_nu_row);
-        free(lambda);
-        free(nu);
         return 0;
-    }
-    jab_int32 offset=ceil(length/(jab_float)32);
+    //one message per edge of the Tanner graph
+    jab_double* nu=lambda+length;
+    memset(nu, 0, graph->edge_number*sizeof(jab_double));
+    //input messages of one check node for the phi approximation
+    jab_double* check_input=nu+graph->edge_number;
     jab_double product=1.0;
 
     //set last bits
@@ -922,30 +1944,31 @@ jab_int32 decodeMessageILL(jab_float* enc, jab_int32* matrix, jab_int32 length,
     }
 
     //check node update
-    jab_int32 count;
     for (jab_int32 kl=0;kl<max_iter;kl++)
     {
         for(jab_int32 j=0;j<height;j++)
         {
-            product=1.0;
-            count=0;
-            for (jab_int32 i=0;i<length;i++)
+            if(phi_approximation)
             {
-                if((matrix[j*offset+i/32] >> (31-i%32)) & 1)
-                {
-                    product*=tanh(-(lambda[i]-nu[j*length+i])*0.5);
-                    index[count]=i;
-                    ++count;
-                }
-                old_nu_row[i]=nu[j*length+i];
+                jab_int32 degree=graph->row_start[j+1]-graph->row_start[j];
+                for (jab_int32 e=graph->row_start[j];e<graph->row_start[j+1];e++)
+                    check_input[e-graph->row_start[j]]=-(lambda[graph->row_column[e]]-nu[e]);
+                checkNodePhi(check_input, nu+graph->row_start[j], degree);
+                for (jab_int32 e=graph->row_start[j];e<graph->row_start[j+1];e++)
+                    nu[e]=-nu[e];
+                continue;
             }
+            product=1.0;
+            for (jab_int32 e=graph->row_start[j];e<graph->row_start[j+1];e++)
+                product*=tanh(-(lambda[graph->row_column[e]]-nu[e])*0.5);
             //update nu
-            for (jab_int32 i=0;i<count;i++)
+            for (jab_int32 e=graph->row_start[j];e<graph->row_start[j+1];e++)
             {
-                if(((matrix[j*offset+index[i]/32] >> (31-index[i]%32)) & 1) && tanh(-(lambda[index[i]]-old_nu_row[index[i]])*0.5) != 0.0)
-                    nu[j*length+index[i]]=-2*atanh(product/tanh(-(lambda[index[i]]-old_nu_row[index[i]])*0.5));
+                jab_double t=tanh(-(lambda[graph->row_column[e]]-nu[e])*0.5);
+                if(t != 0.0)
+                    nu[e]=-2*atanh(product/t);
                 else
-                    nu[j*length+index[i]]=-2*atanh(product);
+                    nu[e]=-2*atanh(product);
             }
         }
         //update lambda
@@ -953,8 +1976,8 @@ jab_int32 decodeMessageILL(jab_float* enc, jab_int32* matrix, jab_int32 length,
         for (jab_int32 i=0;i<length;i++)
         {
             sum=0.0;
-            for(jab_int32 k=0;k<height;k++)
-                sum+=nu[k*length+i];
+            for(jab_int32 k=graph->column_start[i];k<graph->column_start[i+1];k++)
+                sum+=nu[graph->column_edge[k]];
             lambda[i]=(jab_double)2.0*enc[start_pos+i]/var+sum;
             if(lambda[i]<0)
                 dec[start_pos+i]=1;
@@ -966,8 +1989,8 @@ jab_int32 decodeMessageILL(jab_float* enc, jab_int32* matrix, jab_int32 length,
         for (jab_int32 i=0;i< height; i++)
         {
             jab_int32 temp=0;
-            for (jab_int32 j=0;j<length;j++)
-                temp ^= (((matrix[i*offset+j/32] >> (31-j%32)) & 1) & ((dec[start_pos+j] >> 0) & 1)) << 0;
+            for (jab_int32 e=graph->row_start[i];e<graph->row_start[i+1];e++)
+                temp ^= dec[start_pos+graph->row_column[e]] & 1;
             if (temp)
             {
                 *is_correct=(jab_boolean) 0;
@@ -982,10 +2005,6 @@ jab_int32 decodeMessageILL(jab_float* enc, jab_int32* matrix, jab_int32 length,
 #if TEST_MODE
     JAB_REPORT_INFO(("start position:%d, stop position:%d, correct:%d", start_pos, start_pos+length,(jab_int32)*is_correct))
 #endif
-    free(lambda);
-    free(nu);
-    free(old_nu_row);
-    free(index);
     return 1;
 }
 
@@ -993,50 +2012,30 @@ jab_int32 decodeMessageILL(jab_float* enc, jab_int32* matrix, jab_int32 length,
 /**
  * @brief LDPC Iterative belief propagation decoding algorithm for binary codes
  * @param enc the received reliability value for each bit
- * @param matrix the decoding matrixreliability value for each bit
+ * @param graph the Tanner graph of the error correction decoding matrix
  * @param length the encoded data length
  * @param checkbits the rank of the matrix
- * @param height the number of check bits
  * @param max_iter the maximal number of iterations
  * @param is_correct indicating if decodedMessage function could correct all errors
  * @param start_pos indicating the position to start reading in enc array
  * @param dec is the tentative decision after each decoding iteration
+ * @param scratch the decoder scratch memory of the executing thread
  * @return 1: error correction succeded | 0: decoding failed
 */
-jab_int32 decodeMessageBP(jab_float* enc, jab_int32* matrix, jab_int32 length, jab_int32 checkbits, jab_int32 height, jab_int32 max_iter, jab_boolean *is_correct, jab_int32 start_pos, jab_byte* dec)
+jab_int32 decodeMessageBP(jab_float* enc, jab_tanner_graph* graph, jab_int32 length, jab_int32 checkbits, jab_int32 max_iter, jab_boolean *is_correct, jab_int32 start_pos, jab_byte* dec, jab_ldpc_scratch* scratch)
 {
-    jab_double* lambda=(jab_double *)malloc(length * sizeof(jab_double));
+    jab_int32 height=graph->height;
+    jab_boolean phi_approximation=__atomic_load_n(&ldpc_phi_approximation, __ATOMIC_RELAXED);
+    jab_int32 max_degree=phi_approximation ? preparePhiApproximation(graph) : 0;
+    jab_double* lambda=(jab_double *)getLDPCScratch(scratch, (length + height + graph->edge_number + max_degree) * sizeof(jab_double));
     if(lambda == NULL)
-    {
-        reportError("Memory allocation for Lambda in LDPC decoder failed");
-        return 0;
-    }
-    jab_double* old_nu_row=(jab_double *)malloc(length * sizeof(jab_double));
-    if(old_nu_row == NULL)
-    {
-        reportError("Memory allocation for Lambda in LDPC decoder failed");
-        free(lambda);
-        return 0;
-    }
-    jab_double* nu=(jab_double *)malloc(length*height * sizeof(jab_double));
-    if(nu == NULL)
-    {
-        reportError("Memory allocation for nu in LDPC decoder failed");
-        free(old_nu_row);
-        free(lambda);
-        return 0;
-    }
-    memset(nu,0,length*height *sizeof(jab_double));
-    jab_int32* index=(jab_int32 *)malloc(length * sizeof(jab_int32));
-    if(index == NULL)
-    {
-        reportError("Memory allocation for index in LDPC decoder failed");
-        free(old_nu_row);
-        free(lambda);
-        free(nu);
         return 0;
-    }
-    jab_int32 offset=ceil(length/(jab_float)32);
+    jab_double* old_nu=lambda+length;
+    //one message per edge of the Tanner graph
+    jab_double* nu=old_nu+height;
+    memset(nu, 0, graph->edge_number*sizeof(jab_double));
+    //input messages of one check node for the phi approximation
+    jab_double* check_input=nu+graph->edge_number;
     jab_double product=1.0;
 
     //set last bits
@@ -1066,38 +2065,40 @@ jab_int32 decodeMessageBP(jab_float* enc, jab_int32* matrix, jab_int32 length, j
     }
 
     //check node update
-    jab_int32 count;
     for (jab_int32 kl=0;kl<max_iter;kl++)
     {
         for(jab_int32 j=0;j<height;j++)
         {
-            product=1.0;
-            count=0;
-            for (jab_int32 i=0;i<length;i++)
+            if(phi_approximation)
             {
-                if((matrix[j*offset+i/32] >> (31-i%32)) & 1)
+                jab_int32 degree=graph->row_start[j+1]-graph->row_start[j];
+                if(kl==0)
                 {
-                    if (kl==0)
-                        product*=tanh(lambda[i]*0.5);
-                    else
-                        product*=tanh(nu[j*length+i]*0.5);
-                    index[count]=i;
-                    ++count;
+                    for (jab_int32 e=graph->row_start[j];e<graph->row_start[j+1];e++)
+                        check_input[e-graph->row_start[j]]=lambda[graph->row_column[e]];
+                    checkNodePhi(check_input, nu+graph->row_start[j], degree);
                 }
+                else
+                    checkNodePhi(nu+graph->row_start[j], nu+graph->row_start[j], degree);
+                continue;
+            }
+            product=1.0;
+            for (jab_int32 e=graph->row_start[j];e<graph->row_start[j+1];e++)
+            {
+                if (kl==0)
+                    product*=tanh(lambda[graph->row_column[e]]*0.5);
+                else
+                    product*=tanh(nu[e]*0.5);
             }
             //update nu
             jab_double num=0.0, denum=0.0;
-            for (jab_int32 i=0;i<count;i++)
+            for (jab_int32 e=graph->row_start[j];e<graph->row_start[j+1];e++)
             {
-                if(((matrix[j*offset+index[i]/32] >> (31-index[i]%32)) & 1) && tanh(nu[j*length+index[i]]*0.5) != 0.0 && kl>0)// && tanh(-(lambda[index[i]]-old_nu_row[index[i]])/2) != 0.0)
-                {
-                    num     = 1 + product / tanh(nu[j*length+index[i]]*0.5);
-                    denum   = 1 - product / tanh(nu[j*length+index[i]]*0.5);
-                }
-                else if(((matrix[j*offset+index[i]/32] >> (31-index[i]%32)) & 1) && tanh(lambda[index[i]]*0.5) != 0.0 && kl==0)// && tanh(-(lambda[index[i]]-old_nu_row[index[i]])/2) != 0.0)
+                jab_double t = kl>0 ? tanh(nu[e]*0.5) : tanh(lambda[graph->row_column[e]]*0.5);
+                if(t != 0.0)
                 {
-                    num     = 1 + product / tanh(lambda[index[i]]*0.5);
-                    denum   = 1 - product / tanh(lambda[index[i]]*0.5);
+                    num     = 1 + product / t;
+                    denum   = 1 - product / t;
                 }
                 else
                 {
@@ -1105,11 +2106,11 @@ jab_int32 decodeMessageBP(jab_float* enc, jab_int32* matrix, jab_int32 length, j
                     denum   = 1 - product;
                 }
                 if (num == 0.0)
-                    nu[j*length+index[i]]=-1;
+                    nu[e]=-1;
                 else if(denum == 0.0)
-                    nu[j*length+index[i]]= 1;
+                    nu[e]= 1;
                 else
-                    nu[j*length+index[i]]= log(num / denum);
+                    nu[e]= log(num / denum);
             }
         }
         //update lambda
@@ -1117,16 +2118,13 @@ jab_int32 decodeMessageBP(jab_float* enc, jab_int32* matrix, jab_int32 length, j
         for (jab_int32 i=0;i<length;i++)
         {
             sum=0.0;
-            for(jab_int32 k=0;k<height;k++)
-            {
-                sum+=nu[k*length+i];
-                old_nu_row[k]=nu[k*length+i];
-            }
-            for(jab_int32 k=0;k<height;k++)
+            for(jab_int32 k=graph->column_start[i];k<graph->column_start[i+1];k++)
             {
-                if((matrix[k*offset+i/32] >> (31-i%32)) & 1)
-                    nu[k*length+i]=lambda[i]+(sum-old_nu_row[k]);
+                sum+=nu[graph->column_edge[k]];
+                old_nu[k-graph->column_start[i]]=nu[graph->column_edge[k]];
             }
+            for(jab_int32 k=graph->column_start[i];k<graph->column_start[i+1];k++)
+                nu[graph->column_edge[k]]=lambda[i]+(sum-old_nu[k-graph->column_start[i]]);
             lambda[i]=2.0*enc[start_pos+i]/var+sum;
             if(lambda[i]<0)
                 dec[start_pos+i]=1;
@@ -1138,8 +2136,8 @@ jab_int32 decodeMessageBP(jab_float* enc, jab_int32* matrix, jab_int32 length, j
         for (jab_int32 i=0;i< height; i++)
         {
             jab_int32 temp=0;
-            for (jab_int32 j=0;j<length;j++)
-                temp ^= (((matrix[i*offset+j/32] >> (31-j%32)) & 1) & ((dec[start_pos+j] >> 0) & 1)) << 0;
+            for (jab_int32 e=graph->row_start[i];e<graph->row_start[i+1];e++)
+                temp ^= dec[start_pos+graph->row_column[e]] & 1;
             if (temp)
             {
                 *is_correct=(jab_boolean) 0;
@@ -1154,13 +2152,289 @@ jab_int32 decodeMessageBP(jab_float* enc, jab_int32* matrix, jab_int32 length, j
 #if TEST_MODE
     JAB_REPORT_INFO(("start position:%d, stop position:%d, correct:%d", start_pos, start_pos+length,(jab_int32)*is_correct))
 #endif
-    free(lambda);
-    free(nu);
-    free(old_nu_row);
-    free(index);
     return 1;
 }
 
+/**
+ * @brief LDPC normalized min-sum decoding algorithm for binary codes
+ * @param enc the received reliability value for each bit
+ * @param graph the Tanner graph of the error correction decoding matrix
+ * @param length the encoded data length
+ * @param checkbits the rank of the matrix
+ * @param max_iter the maximal number of iterations
+ * @param is_correct indicating if decodedMessage function could correct all errors
+ * @param start_pos indicating the position to start reading in enc array
+ * @param dec is the tentative decision after each decoding iteration
+ * @param scratch the decoder scratch memory of the executing thread
+ * @return 1: success | 0: fatal error (out of memory)
+*/
+jab_int32 decodeMessageMinSum(jab_float* enc, jab_tanner_graph* graph, jab_int32 length, jab_int32 checkbits, jab_int32 max_iter, jab_boolean *is_correct, jab_int32 start_pos, jab_byte* dec, jab_ldpc_scratch* scratch)
+{
+    jab_int32 height=graph->height;
+    jab_float* lambda=(jab_float *)getLDPCScratch(scratch, (length + 2*graph->edge_number) * sizeof(jab_float));
+    if(lambda == NULL)
+        return 0;
+    //check to variable (r) and variable to check (q) message of each edge
+    jab_float* r=lambda+length;
+    memset(r, 0, 2*graph->edge_number*sizeof(jab_float));
+    jab_float* q=r + graph->edge_number;
+
+    //set last bits
+    for (jab_int32 i=length-1;i >= length-(height-checkbits);i--)
+    {
+        enc[start_pos+i]=1.0;
+        dec[start_pos+i]=0;
+    }
+
+    jab_double meansum=0.0;
+    for (jab_int32 i=0;i<length;i++)
+        meansum+=enc[start_pos+i];
+
+    //calc variance
+    meansum/=length;
+    jab_double var=0.0;
+    for (jab_int32 i=0;i<length;i++)
+        var+=(enc[start_pos+i]-meansum)*(enc[start_pos+i]-meansum);
+    var/=(length-1);
+
+    //initialize lambda and the variable to check messages
+    for (jab_int32 i=0;i<length;i++)
+    {
+        if(dec[start_pos+i])
+            enc[start_pos+i]=-enc[start_pos+i];
+        lambda[i]=(jab_float)(2.0*enc[start_pos+i]/var);
+    }
+    for (jab_int32 e=0;e<graph->edge_number;e++)
+        q[e]=lambda[graph->row_column[e]];
+
+    for (jab_int32 kl=0;kl<max_iter;kl++)
+    {
+        //check node update: the magnitude is the scaled minimum over the other edges
+        for(jab_int32 j=0;j<height;j++)
+        {
+            jab_float min1=INFINITY, min2=INFINITY;
+            jab_int32 min_edge=-1;
+            jab_int32 sign=0;
+            for (jab_int32 e=graph->row_start[j];e<graph->row_start[j+1];e++)
+            {
+                jab_float mag=fabsf(q[e]);
+                sign^=(q[e]<0);
+                if(mag<min1)
+                {
+                    min2=min1;
+                    min1=mag;
+                    min_edge=e;
+                }
+                else if(mag<min2)
+                    min2=mag;
+            }
+            for (jab_int32 e=graph->row_start[j];e<graph->row_start[j+1];e++)
+            {
+                jab_float mag=LDPC_MIN_SUM_SCALE * (e == min_edge ? min2 : min1);
+                if(mag == INFINITY)		//check node with a single edge
+                    mag=0;
+                r[e]=(sign ^ (q[e]<0)) ? -mag : mag;
+            }
+        }
+        //variable node update
+        for (jab_int32 i=0;i<length;i++)
+        {
+            jab_float sum=lambda[i];
+            for(jab_int32 k=graph->column_start[i];k<graph->column_start[i+1];k++)
+                sum+=r[graph->column_edge[k]];
+            for(jab_int32 k=graph->column_start[i];k<graph->column_start[i+1];k++)
+                q[graph->column_edge[k]]=sum-r[graph->column_edge[k]];
+            dec[start_pos+i]=sum<0 ? 1 : 0;
+        }
+        //check matrix times dec
+        *is_correct=(jab_boolean) 1;
+        for (jab_int32 i=0;i< height; i++)
+        {
+            jab_int32 temp=0;
+            for (jab_int32 e=graph->row_start[i];e<graph->row_start[i+1];e++)
+                temp ^= dec[start_pos+graph->row_column[e]] & 1;
+            if (temp)
+            {
+                *is_correct=(jab_boolean) 0;
+                break;//message not correct
+            }
+        }
+        if(*is_correct)
+            break;
+    }
+#if TEST_MODE
+    JAB_REPORT_INFO(("start position:%d, stop position:%d, correct:%d", start_pos, start_pos+length,(jab_int32)*is_correct))
+#endif
+    return 1;
+}
+
+/**
+ * @brief LDPC layered normalized min-sum decoding algorithm for binary codes
+ * @param enc the received reliability value for each bit
+ * @param graph the Tanner graph of the error correction decoding matrix
+ * @param length the encoded data length
+ * @param checkbits the rank of the matrix
+ * @param max_iter the maximal number of iterations
+ * @param is_correct indicating if decodedMessage function could correct all errors
+ * @param start_pos indicating the position to start reading in enc array
+ * @param dec is the tentative decision after each decoding iteration
+ * @param scratch the decoder scratch memory of the executing thread
+ * @return 1: success | 0: fatal error (out of memory)
+*/
+jab_int32 decodeMessageLayered(jab_float* enc, jab_tanner_graph* graph, jab_int32 length, jab_int32 checkbits, jab_int32 max_iter, jab_boolean *is_correct, jab_int32 start_pos, jab_byte* dec, jab_ldpc_scratch* scratch)
+{
+    jab_int32 height=graph->height;
+    //a posteriori reliability of each bit
+    jab_float* lambda=(jab_float *)getLDPCScratch(scratch, (length + graph->edge_number) * sizeof(jab_float) + height * sizeof(jab_byte));
+    if(lambda == NULL)
+        return 0;
+    //check to variable message of each edge
+    jab_float* r=lambda+length;
+    memset(r, 0, graph->edge_number*sizeof(jab_float));
+    jab_byte* syndrome=(jab_byte *)(r+graph->edge_number);
+    memset(syndrome, 0, height*sizeof(jab_byte));
+
+    //set last bits
+    for (jab_int32 i=length-1;i >= length-(height-checkbits);i--)
+    {
+        enc[start_pos+i]=1.0;
+        dec[start_pos+i]=0;
+    }
+
+    jab_double meansum=0.0;
+    for (jab_int32 i=0;i<length;i++)
+        meansum+=enc[start_pos+i];
+
+    //calc variance
+    meansum/=length;
+    jab_double var=0.0;
+    for (jab_int32 i=0;i<length;i++)
+        var+=(enc[start_pos+i]-meansum)*(enc[start_pos+i]-meansum);
+    var/=(length-1);
+
+    //initialize lambda
+    for (jab_int32 i=0;i<length;i++)
+    {
+        if(dec[start_pos+i])
+            enc[start_pos+i]=-enc[start_pos+i];
+        lambda[i]=(jab_float)(2.0*enc[start_pos+i]/var);
+        dec[start_pos+i]=lambda[i]<0 ? 1 : 0;
+    }
+    //the syndrome is kept up to date while decoding
+    jab_int32 unsatisfied=0;
+    for (jab_int32 j=0;j<height;j++)
+    {
+        for (jab_int32 e=graph->row_start[j];e<graph->row_start[j+1];e++)
+            syndrome[j] ^= dec[start_pos+graph->row_column[e]];
+        unsatisfied+=syndrome[j];
+    }
+
+    for (jab_int32 kl=0;kl<max_iter && unsatisfied>0;kl++)
+    {
+        //process the check nodes one after another, each one uses the beliefs updated by the previous ones
+        for(jab_int32 j=0;j<height && unsatisfied>0;j++)
+        {
+            jab_float min1=INFINITY, min2=INFINITY;
+            jab_int32 min_edge=-1;
+            jab_int32 sign=0;
+            for (jab_int32 e=graph->row_start[j];e<graph->row_start[j+1];e++)
+            {
+                jab_float q=lambda[graph->row_column[e]] - r[e];
+                jab_float mag=fabsf(q);
+                sign^=(q<0);
+                if(mag<min1)
+                {
+                    min2=min1;
+                    min1=mag;
+                    min_edge=e;
+                }
+                else if(mag<min2)
+                    min2=mag;
+            }
+            for (jab_int32 e=graph->row_start[j];e<graph->row_start[j+1];e++)
+            {
+                jab_int32 i=graph->row_column[e];
+                jab_float q=lambda[i] - r[e];
+                jab_float mag=LDPC_MIN_SUM_SCALE * (e == min_edge ? min2 : min1);
+                if(mag == INFINITY)		//check node with a single edge
+                    mag=0;
+                r[e]=(sign ^ (q<0)) ? -mag : mag;
+                lambda[i]=q + r[e];
+                //update the syndrome of all check nodes of a flipped bit
+                jab_byte bit=lambda[i]<0 ? 1 : 0;
+                if(bit != dec[start_pos+i])
+                {
+                    dec[start_pos+i]=bit;
+                    for(jab_int32 k=graph->column_start[i];k<graph->column_start[i+1];k++)
+                    {
+                        jab_int32 row=graph->column_row[k];
+                        unsatisfied+=syndrome[row] ? -1 : 1;
+                        syndrome[row]^=1;
+                    }
+                }
+            }
+        }
+    }
+    *is_correct=(jab_boolean)(unsatisfied == 0);
+#if TEST_MODE
+    JAB_REPORT_INFO(("start position:%d, stop position:%d, correct:%d", start_pos, start_pos+length,(jab_int32)*is_correct))
+#endif
+    return 1;
+}
+
+/**
+ * @brief Run the selected soft decision decoder on one sub-block
+ * @param enc the received reliability value for each bit
+ * @param graph the Tanner graph of the error correction decoding matrix
+ * @param length the encoded data length
+ * @param checkbits the rank of the matrix
+ * @param max_iter the maximal number of iterations
+ * @param is_correct indicating if all errors could be corrected
+ * @param start_pos indicating the position to start reading in enc array
+ * @param dec is the tentative decision after each decoding iteration
+ * @param scratch the decoder scratch memory of the executing thread
+ * @return 1: success | 0: fatal error (out of memory)
+*/
+static jab_int32 decodeMessageSoft(jab_float* enc, jab_tanner_graph* graph, jab_int32 length, jab_int32 checkbits, jab_int32 max_iter, jab_boolean *is_correct, jab_int32 start_pos, jab_byte* dec, jab_ldpc_scratch* scratch)
+{
+    switch(__atomic_load_n(&ldpc_soft_decoder, __ATOMIC_RELAXED))
+    {
+    case LDPC_DECODER_MIN_SUM:
+        return decodeMessageMinSum(enc, graph, length, checkbits, max_iter, is_correct, start_pos, dec, scratch);
+    case LDPC_DECODER_LAYERED:
+        return decodeMessageLayered(enc, graph, length, checkbits, max_iter, is_correct, start_pos, dec, scratch);
+    default:
+        return decodeMessageBP(enc, graph, length, checkbits, max_iter, is_correct, start_pos, dec, scratch);
+    }
+}
+
+/**
+ * @brief Enable the table based approximation of the check node update in the belief propagation decoders
+ * @param enable 1: approximate Gallager's function phi by a table | 0: use tanh and atanh (default)
+*/
+void setLDPCPhiApproximation(jab_boolean enable)
+{
+    __atomic_store_n(&ldpc_phi_approximation, enable, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Select the hard decision LDPC decoder used for the message decoding
+ * @param decoder LDPC_HARD_DECODER_GDBF (default) | LDPC_HARD_DECODER_BIT_FLIP
+*/
+void setLDPCHardDecoder(jab_int32 decoder)
+{
+    __atomic_store_n(&ldpc_hard_decoder, decoder, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Select the soft decision LDPC decoder used for the message and metadata decoding
+ * @param decoder LDPC_DECODER_BP (default) | LDPC_DECODER_MIN_SUM | LDPC_DECODER_LAYERED
+*/
+void setLDPCDecoder(jab_int32 decoder)
+{
+    __atomic_store_n(&ldpc_soft_decoder, decoder, __ATOMIC_RELAXED);
+}
+
 /**
  * @brief LDPC decoding to performe soft decision
  * @param enc the probability value for each bit position
@@ -1217,149 +2491,55 @@ jab_int32 decodeLDPC(jab_float* enc, jab_int32 length, jab_int32 wc, jab_int32 w
         decoding_iterations--;
 
 
-    //parity check matrix
-    jab_int32* matrixA;
-    if(wr > 0)
-        matrixA = createMatrixA(wc, wr,Pg_sub_block);
-    else
-        matrixA = createMetadataMatrixA(wc, Pg_sub_block);
-    if(matrixA == NULL)
+    //parity check matrices of the regular and the last sub-block
+    jab_ldpc_blocks blocks;
+    blocks.data = dec;
+    blocks.enc = enc;
+    blocks.deadline = 0;
+    blocks.block_length = Pg_sub_block;
+    blocks.max_iter = max_iter;
+    blocks.last_block = -1;
+    blocks.ldpc_last = NULL;
+    blocks.ldpc = getLDPCMatrix(wc, wr, Pg_sub_block, 0);
+    if(blocks.ldpc == NULL)
     {
         reportError("LDPC matrix could not be created in decoder.");
         return 0;
     }
-
-    jab_boolean encode=0;
-    if(GaussJordan(matrixA, wc, wr, Pg_sub_block, &matrix_rank,encode))
+    if(decoding_iterations != nb_sub_blocks)
     {
-        reportError("Gauss Jordan Elimination in LDPC encoder failed.");
-        free(matrixA);
+        blocks.last_block = decoding_iterations;
+        blocks.last_length = Pg - decoding_iterations * Pg_sub_block;
+        blocks.ldpc_last = getLDPCMatrix(wc, wr, blocks.last_length, 0);
+        if(blocks.ldpc_last == NULL)
+        {
+            reportError("LDPC matrix could not be created in decoder.");
+            releaseLDPCMatrix(blocks.ldpc);
+            return 0;
+        }
+    }
+    //the sub-blocks are independent, decode them (in parallel) before the message bits are gathered
+    jab_int32 result = decodeSubBlocks(&blocks, nb_sub_blocks);
+    if(result != 1)
+    {
+        if(result < 0)
+            reportError("LDPC decoder error.");
+        releaseLDPCMatrix(blocks.ldpc_last);
+        releaseLDPCMatrix(blocks.ldpc);
         return 0;
     }
-#if TEST_MODE
-	JAB_REPORT_INFO(("GaussJordan matrix done"))
-#endif // TEST_MODE
     jab_int32 old_Pg_sub=Pg_sub_block;
     jab_int32 old_Pn_sub=Pn_sub_block;
     for (jab_int32 iter = 0; iter < nb_sub_blocks; iter++)
     {
-        if(decoding_iterations != nb_sub_blocks && iter == decoding_iterations)
+        jab_ldpc_matrix* ldpc = blocks.ldpc;
+        if(iter == blocks.last_block)
         {
-            matrix_rank=0;
-            Pg_sub_block=Pg - decoding_iterations * Pg_sub_block;
+            ldpc = blocks.ldpc_last;
+            Pg_sub_block=blocks.last_length;
             Pn_sub_block=Pg_sub_block * (wr-wc) / wr;
-            jab_int32* matrixA1 = createMatrixA(wc, wr, Pg_sub_block);
-            if(matrixA1 == NULL)
-            {
-                reportError("LDPC matrix could not be created in decoder.");
-                return 0;
-            }
-            jab_boolean encode=0;
-            if(GaussJordan(matrixA1, wc, wr, Pg_sub_block, &matrix_rank,encode))
-            {
-                reportError("Gauss Jordan Elimination in LDPC encoder failed.");
-                free(matrixA1);
-                return 0;
-            }
-            //ldpc decoding
-            //first check syndrom
-            jab_boolean is_correct=1;
-            jab_int32 offset=ceil(Pg_sub_block/(jab_float)32);
-            for (jab_int32 i=0;i< matrix_rank; i++)
-            {
-                jab_int32 temp=0;
-                for (jab_int32 j=0;j<Pg_sub_block;j++)
-                    temp ^= (((matrixA1[i*offset+j/32] >> (31-j%32)) & 1) & ((dec[iter*old_Pg_sub+j] >> 0) & 1)) << 0; //
-                if (temp)
-                {
-                    is_correct=(jab_boolean) 0; //message not correct
-                    break;
-                }
-            }
-
-            if(is_correct==0)
-            {
-                jab_int32 start_pos=iter*old_Pg_sub;
-                jab_int32 success=decodeMessageBP(enc, matrixA1, Pg_sub_block, matrix_rank, wr<4 ? Pg_sub_block/2 : Pg_sub_block/wr*wc, max_iter, &is_correct,start_pos,dec);
-                if(success == 0)
-                {
-                    reportError("LDPC decoder error.");
-                    free(matrixA1);
-                    return 0;
-                }
-            }
-            if(is_correct==0)
-            {
-                jab_boolean is_correct=1;
-                for (jab_int32 i=0;i< matrix_rank; i++)
-                {
-                    jab_int32 temp=0;
-                    for (jab_int32 j=0;j<Pg_sub_block;j++)
-                        temp ^= (((matrixA1[i*offset+j/32] >> (31-j%32)) & 1) & ((dec[iter*old_Pg_sub+j] >> 0) & 1)) << 0;
-                    if (temp)
-                    {
-                        is_correct=(jab_boolean) 0;//message not correct
-                        break;
-                    }
-                }
-                if(is_correct==0)
-                {
- //                   reportError("To many errors in message. LDPC decoding failed.");
-                    free(matrixA1);
-                    return 0;
-                }
-            }
-            free(matrixA1);
-        }
-        else
-        {
-            //ldpc decoding
-            //first check syndrom
-            jab_boolean is_correct=1;
-            jab_int32 offset=ceil(Pg_sub_block/(jab_float)32);
-            for (jab_int32 i=0;i< matrix_rank; i++)
-            {
-                jab_int32 temp=0;
-                for (jab_int32 j=0;j<Pg_sub_block;j++)
-                    temp ^= (((matrixA[i*offset+j/32] >> (31-j%32)) & 1) & ((dec[iter*old_Pg_sub+j] >> 0) & 1)) << 0;
-                if (temp)
-                {
-                    is_correct=(jab_boolean) 0;//message not correct
-                    break;
-                }
-            }
-
-            if(is_correct==0)
-            {
-                jab_int32 start_pos=iter*old_Pg_sub;
-                jab_int32 success=decodeMessageBP(enc, matrixA, Pg_sub_block, matrix_rank, wr<4 ? Pg_sub_block/2 : Pg_sub_block/wr*wc, max_iter, &is_correct, start_pos,dec);
-                if(success == 0)
-                {
-                    reportError("LDPC decoder error.");
-                    free(matrixA);
-                    return 0;
-                }
-                is_correct=1;
-                for (jab_int32 i=0;i< matrix_rank; i++)
-                {
-                    jab_int32 temp=0;
-                    for (jab_int32 j=0;j<Pg_sub_block;j++)
-                        temp ^= (((matrixA[i*offset+j/32] >> (31-j%32)) & 1) & ((dec[iter*old_Pg_sub+j] >> 0) & 1)) << 0;
-                    if (temp)
-                    {
-                        is_correct=(jab_boolean)0;//message not correct
-                        break;
-                    }
-                }
-                if(is_correct==0)
-                {
-       //             reportError("To many errors in message. LDPC decoding failed.");
-                    free(matrixA);
-                    return 0;
-                }
-            }
         }
-
+        matrix_rank = ldpc->matrix_rank;
         jab_int32 loop=0;
         for (jab_int32 i=iter*old_Pg_sub;i < iter * old_Pg_sub + Pn_sub_block; i++)
         {
@@ -1367,6 +2547,7 @@ jab_int32 decodeLDPC(jab_float* enc, jab_int32 length, jab_int32 wc, jab_int32 w
             loop++;
         }
     }
-    free(matrixA);
+    releaseLDPCMatrix(blocks.ldpc_last);
+    releaseLDPCMatrix(blocks.ldpc);
     return decoded_data_len;
 }
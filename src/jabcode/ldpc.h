@@ -16,13 +16,82 @@
 
 #define LPDC_METADATA_SEED 	38545
 #define LPDC_MESSAGE_SEED 	785465
+#define LDPC_FLIP_SEED		61667		//seed of the tie breaking in the bit flipping decoders, offset by the sub-block position
 
 static const jab_vector2d default_ecl = {4, 7};		//default (wc, wr) for LDPC, corresponding to the values in the specification.
 //static const jab_vector2d default_ecl = {5, 6};	//This (wc, wr) could be used, if higher robustness is preferred to capacity.
 
+#define LDPC_MIN_SUM_SCALE	0.75f	//normalization factor of the check node messages in the min-sum decoder
+
+#ifndef LDPC_PHI_APPROXIMATION
+#define LDPC_PHI_APPROXIMATION	0		//default of setLDPCPhiApproximation
+#endif
+
+#define LDPC_GDBF_ITER_FACTOR	4		//the gradient descent bit flipping iterations are cheap but more of them are needed
+
+#define LDPC_CACHE_SIZE		16		//maximal number of matrices kept in the LDPC matrix cache
+
+#define LDPC_M4RI_MAX_BITS	8		//maximal number of pivot rows combined in one lookup table of the Gauss-Jordan elimination
+
+/**
+ * @brief Tanner graph of a parity check matrix, the edges are stored in compressed sparse row order
+*/
+typedef struct {
+	jab_int32	height;					///< the number of check nodes
+	jab_int32	length;					///< the number of variable nodes
+	jab_int32	edge_number;
+	jab_int32*	row_start;				///< first edge of each check node, height+1 entries
+	jab_int32*	row_column;				///< variable node of each edge, ascending in each row
+	jab_int32*	column_start;			///< first entry of each variable node in column_edge, length+1 entries
+	jab_int32*	column_edge;			///< edges of each variable node, ascending by check node
+	jab_int32*	column_row;				///< check node of each entry in column_edge
+	jab_int32	data[];
+}jab_tanner_graph;
+
+/**
+ * @brief LDPC matrix, as kept in the matrix cache
+ *
+ * The encoder solves the matrix_rank parity bits from the sparse parity check rows. It is laid out as
+ * gap, edge_number, row_start[matrix_rank+1], row_column[edge_number], pivot_column[matrix_rank] and
+ * the gap x gap inverse of the gap system, in rows of (gap+31)/32 words. Each of the first matrix_rank-gap
+ * rows solves its pivot column by back-substitution, the remaining gap rows give the gap columns.
+*/
+typedef struct {
+	jab_int32	wc;
+	jab_int32	wr;						///< 0 for metadata matrices
+	jab_int32	capacity;
+	jab_boolean	encode;
+	jab_int32	height;					///< the number of parity check rows
+	jab_int32	matrix_rank;
+	jab_int32*	matrix;					///< Parity check matrix after Gauss Jordan elimination (decoder only)
+	jab_int32*	encoder;				///< Approximate lower triangular encoder (encoder only), see below
+	jab_tanner_graph* graph;			///< Tanner graph of the parity check matrix (decoder only)
+	jab_int32	ref_count;
+	jab_uint64	last_used;
+	jab_boolean	cached;				///< cached and precomputed matrices are not freed on release
+}jab_ldpc_matrix;
+
+/**
+ * @brief Scratch memory of the LDPC decoders, reused over the decoded sub-blocks
+*/
+typedef struct {
+	void*		buffer;
+	jab_int32	size;					///< the buffer size in bytes
+}jab_ldpc_scratch;
+
+extern jab_ldpc_matrix ldpc_tables[];		//precomputed matrices generated by tools/ldpc_tablegen.c, sorted by (wc, wr, capacity, encode)
+extern const jab_int32 ldpc_table_number;
+
 extern jab_data *encodeLDPC(jab_data* data, jab_int32* coderate_params, jab_int32* from_to, jab_int32 index);
-extern jab_int32 decodeLDPChd(jab_byte* data, jab_int32 length, jab_int32 wc, jab_int32 wr);
+extern jab_int32 decodeLDPChd(jab_byte* data, jab_int32 length, jab_int32 wc, jab_int32 wr, jab_uint64 deadline);
 extern jab_int32 decodeLDPC(jab_float* enc, jab_int32 length, jab_int32 wc, jab_int32 wr, jab_byte* dec);
+extern jab_ldpc_matrix* getLDPCMatrix(jab_int32 wc, jab_int32 wr, jab_int32 capacity, jab_boolean encode);
+extern void releaseLDPCMatrix(jab_ldpc_matrix* ldpc);
+extern jab_ldpc_matrix* createLDPCMatrix(jab_int32 wc, jab_int32 wr, jab_int32 capacity, jab_boolean encode);
+extern void freeLDPCMatrix(jab_ldpc_matrix* ldpc);
+extern jab_tanner_graph* createTannerGraph(jab_int32* matrix, jab_int32 length, jab_int32 height);
+extern jab_int32 decodeMessageBP(jab_float* enc, jab_tanner_graph* graph, jab_int32 length, jab_int32 checkbits, jab_int32 max_iter, jab_boolean *is_correct, jab_int32 start_pos, jab_byte* dec, jab_ldpc_scratch* scratch);
+extern jab_int32 decodeMessageILL(jab_float* enc, jab_tanner_graph* graph, jab_int32 length, jab_int32 checkbits, jab_int32 max_iter, jab_boolean *is_correct, jab_int32 start_pos, jab_byte* dec, jab_ldpc_scratch* scratch);
 
 
 #endif
@@ -0,0 +1,203 @@
+/**
+ * libjabcode - JABCode Encoding/Decoding Library
+ *
+ * Copyright 2016 by Fraunhofer SIT. All rights reserved.
+ * See LICENSE file for full terms of use and distribution.
+ *
+ * Contact: Huajian Liu <liu@sit.fraunhofer.de>
+ *			Waldemar Berchtold <waldemar.berchtold@sit.fraunhofer.de>
+ *
+ * @file parallel.c
+ * @brief Parallel task execution
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include "jabcode.h"
+#include "parallel.h"
+
+static jab_int32 thread_number = 1;		//can be changed while other threads decode, hence accessed atomically
+
+/**
+ * @brief Work items shared by the threads of one runParallel call
+*/
+typedef struct jab_parallel_job {
+	jab_parallel_task	task;
+	void*				context;
+	jab_int32			item_number;
+	jab_int32			next_item;
+	jab_int32			max_threads;	///< the thread indices stay below this number
+	jab_int32			joined;			///< the number of threads that joined the job, the caller included
+	jab_int32			running;		///< the number of pool threads still working on the job
+	struct jab_parallel_job*	next;
+}jab_parallel_job;
+
+//the pool threads are started on first use and wait for jobs as long as the process runs
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_job_added = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_job_done = PTHREAD_COND_INITIALIZER;
+static jab_parallel_job* pool_jobs = NULL;		//the jobs of the running runParallel calls
+static jab_int32 pool_size = 0;
+
+/**
+ * @brief Set the number of threads used by the library
+ * @param number the number of threads, 1 for serial processing (default), <= 0 for the number of online processors
+*/
+void setThreadNumber(jab_int32 number)
+{
+	if(number <= 0)
+	{
+#ifdef _SC_NPROCESSORS_ONLN
+		number = (jab_int32)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		if(number <= 0) number = 1;
+	}
+	__atomic_store_n(&thread_number, MIN(number, MAX_THREAD_NUMBER), __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Get the number of threads used by the library
+ * @return the number of threads
+*/
+jab_int32 getThreadNumber(void)
+{
+	return __atomic_load_n(&thread_number, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Process work items until all are taken
+ * @param job the job
+ * @param thread_index the thread index in the job
+*/
+static void runItems(jab_parallel_job* job, jab_int32 thread_index)
+{
+	jab_int32 index;
+	while((index = __atomic_fetch_add(&job->next_item, 1, __ATOMIC_RELAXED)) < job->item_number)
+		job->task(job->context, index, thread_index);
+}
+
+/**
+ * @brief Find a job with untaken work items and a free thread index, the pool lock must be held
+ * @return the job | NULL if there is none
+*/
+static jab_parallel_job* findOpenJob(void)
+{
+	for(jab_parallel_job* job = pool_jobs; job; job = job->next)
+	{
+		if(job->joined < job->max_threads && __atomic_load_n(&job->next_item, __ATOMIC_RELAXED) < job->item_number)
+			return job;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Pool thread, joins the open jobs
+ * @param args unused
+ * @return NULL
+*/
+static void* runPoolThread(void* args)
+{
+	(void)args;
+	pthread_mutex_lock(&pool_mutex);
+	while(1)
+	{
+		jab_parallel_job* job = findOpenJob();
+		if(job == NULL)
+		{
+			pthread_cond_wait(&pool_job_added, &pool_mutex);
+			continue;
+		}
+		jab_int32 thread_index = job->joined++;
+		job->running++;
+		pthread_mutex_unlock(&pool_mutex);
+		runItems(job, thread_index);
+		pthread_mutex_lock(&pool_mutex);
+		if(--job->running == 0)
+			pthread_cond_broadcast(&pool_job_done);
+	}
+	return NULL;
+}
+
+/**
+ * @brief Start pool threads until the pool has the given size, the pool lock must be held
+ * @param size the pool size
+*/
+static void growPool(jab_int32 size)
+{
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	while(pool_size < size)
+	{
+		pthread_t thread;
+		if(pthread_create(&thread, &attr, runPoolThread, NULL) != 0)
+			break;
+		pool_size++;
+	}
+	pthread_attr_destroy(&attr);
+}
+
+/**
+ * @brief Run a task for all work items, the items are distributed over the calling thread and the pool threads
+ * @param task the task
+ * @param context the task context
+ * @param item_number the number of work items
+ * @param max_threads the maximal number of threads, usually getThreadNumber(). The thread indices passed to the
+ *        task stay below it, so per-thread buffers are sized with the value passed here.
+*/
+void runParallel(jab_parallel_task task, void* context, jab_int32 item_number, jab_int32 max_threads)
+{
+	jab_int32 workers = MIN(MIN(max_threads, MAX_THREAD_NUMBER), item_number);
+	jab_parallel_job job = {task, context, item_number, 0, workers, 1, 0, NULL};
+	//pool threads that are busy with other jobs or can not be started leave their items to the other threads
+	if(workers > 1)
+	{
+		pthread_mutex_lock(&pool_mutex);
+		growPool(workers - 1);
+		job.next = pool_jobs;
+		pool_jobs = &job;
+		pthread_cond_broadcast(&pool_job_added);
+		pthread_mutex_unlock(&pool_mutex);
+	}
+	//the calling thread is thread 0
+	runItems(&job, 0);
+	if(workers > 1)
+	{
+		//no thread can join the job once it is unlinked, then wait for the threads still working on it
+		pthread_mutex_lock(&pool_mutex);
+		for(jab_parallel_job** link = &pool_jobs; *link; link = &(*link)->next)
+		{
+			if(*link == &job)
+			{
+				*link = job.next;
+				break;
+			}
+		}
+		while(job.running > 0)
+			pthread_cond_wait(&pool_job_done, &pool_mutex);
+		pthread_mutex_unlock(&pool_mutex);
+	}
+}
+
+/**
+ * @brief Get the current time
+ * @return the time in microseconds
+*/
+jab_uint64 getTimeMicroseconds(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (jab_uint64)ts.tv_sec * 1000000 + (jab_uint64)ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief Check if a deadline has passed
+ * @param deadline the deadline in microseconds, 0 for no deadline
+ * @return JAB_SUCCESS if passed | JAB_FAILURE
+*/
+jab_boolean isDeadlinePassed(jab_uint64 deadline)
+{
+	return deadline > 0 && getTimeMicroseconds() >= deadline;
+}
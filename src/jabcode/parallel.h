@@ -0,0 +1,32 @@
+/**
+ * libjabcode - JABCode Encoding/Decoding Library
+ *
+ * Copyright 2016 by Fraunhofer SIT. All rights reserved.
+ * See LICENSE file for full terms of use and distribution.
+ *
+ * Contact: Huajian Liu <liu@sit.fraunhofer.de>
+ *			Waldemar Berchtold <waldemar.berchtold@sit.fraunhofer.de>
+ *
+ * @file parallel.h
+ * @brief Parallel task execution header
+ */
+
+#ifndef _PARALLEL_H
+#define _PARALLEL_H
+
+#define MAX_THREAD_NUMBER	64
+
+/**
+ * @brief A task processing one work item
+ * @param context the task context
+ * @param index the work item index
+ * @param thread_index the index of the executing thread, below the max_threads of runParallel, e.g. for per-thread scratch buffers
+*/
+typedef void (*jab_parallel_task)(void* context, jab_int32 index, jab_int32 thread_index);
+
+extern jab_int32 getThreadNumber(void);
+extern void runParallel(jab_parallel_task task, void* context, jab_int32 item_number, jab_int32 max_threads);
+extern jab_uint64 getTimeMicroseconds(void);
+extern jab_boolean isDeadlinePassed(jab_uint64 deadline);
+
+#endif
@@ -1,7 +1,5 @@
 #include "pseudo_random.h"
 
-static uint64_t lcg64_seed = 42;
-
 uint32_t temper(uint32_t x)
 {
     x ^= x>>11;
@@ -11,13 +9,13 @@ uint32_t temper(uint32_t x)
     return x;
 }
 
-uint32_t lcg64_temper()
+uint32_t lcg64_temper(jab_lcg64* generator)
 {
-    lcg64_seed = 6364136223846793005ULL * lcg64_seed + 1;
-    return temper(lcg64_seed >> 32);
+    generator->seed = 6364136223846793005ULL * generator->seed + 1;
+    return temper(generator->seed >> 32);
 }
 
-void setSeed(uint64_t seed)
+void setSeed(jab_lcg64* generator, uint64_t seed)
 {
-	lcg64_seed = seed;
+	generator->seed = seed;
 }
@@ -4,5 +4,12 @@
 #define UINT32_MAX 4294967295
 #endif
 
-void setSeed(uint64_t seed);
-uint32_t lcg64_temper();
+/**
+ * @brief State of the 64-bit linear congruential generator, one per caller to keep the sequences reentrant
+*/
+typedef struct {
+    uint64_t seed;
+}jab_lcg64;
+
+void setSeed(jab_lcg64* generator, uint64_t seed);
+uint32_t lcg64_temper(jab_lcg64* generator);
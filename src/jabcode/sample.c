@@ -27,7 +27,7 @@
  * @param pt the transformation matrix
  * @param side_size the symbol size in module
  * @param symbol_type the symbol type
- * @param ch the binarized color channels of the bitmap
+ * @param ch the bit-packed binarized color channels of the bitmap
  * @return the sampled symbol matrix
 */
 jab_bitmap* sampleSymbol(jab_bitmap* bitmap, jab_perspective_transform* pt, jab_vector2d side_size, jab_int32 symbol_type, jab_bitmap* ch[])
@@ -96,19 +96,18 @@ jab_bitmap* sampleSymbol(jab_bitmap* bitmap, jab_perspective_transform* pt, jab_
 					else
 					{
 						//get the majority of pixel values in 3x3 neighborhood as the sampled value
+						//neighbors outside the bitmap are replaced by the center row or column
+						jab_int32 minx = MAX(mapped_x - 1, 0);
+						jab_int32 maxx = MIN(mapped_x + 1, bitmap->width - 1);
 						jab_int32 sum = 0;
-						for(jab_int32 dx=-1; dx<=1; dx++)
+						for(jab_int32 dy=-1; dy<=1; dy++)
 						{
-							for(jab_int32 dy=-1; dy<=1; dy++)
-							{
-								jab_int32 px = mapped_x + dx;
-								jab_int32 py = mapped_y + dy;
-								if(px < 0 || px > bitmap->width - 1)  px = mapped_x;
-								if(py < 0 || py > bitmap->height - 1) py = mapped_y;
-								sum += ch[c]->pixel[py*ch[c]->width + px];
-							}
+							jab_int32 py = mapped_y + dy;
+							if(py < 0 || py > bitmap->height - 1) py = mapped_y;
+							const jab_byte* row = getBinaryRow(ch[c], py);
+							sum += countBinaryPixels(row, minx, maxx + 1) + (2 - (maxx - minx)) * getRowPixel(row, mapped_x);
 						}
-						jab_byte ave = sum > 4*255 ? 255 : 0;
+						jab_byte ave = sum > 4 ? 255 : 0;
 						matrix->pixel[i*mtx_bytes_per_row + j*mtx_bytes_per_pixel + c] = ave;
 					}
 				}
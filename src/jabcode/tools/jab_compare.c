@@ -0,0 +1,371 @@
+/**
+ * libjabcode - JABCode Encoding/Decoding Library
+ *
+ * Copyright 2016 by Fraunhofer SIT. All rights reserved.
+ * See LICENSE file for full terms of use and distribution.
+ *
+ * Contact: Huajian Liu <liu@sit.fraunhofer.de>
+ *			Waldemar Berchtold <waldemar.berchtold@sit.fraunhofer.de>
+ *
+ * @file jab_compare.c
+ * @brief Bit identity check of the parallel and vectorized code paths
+ *
+ * Usage: jab_compare [threads]
+ * Every case runs with one thread and with the given number of threads (default 4), and both runs
+ * must give identical results: the binarized planes of the block and the integral binarizer, the
+ * decoded data of whole symbols and the LDPC encoded and hard decision decoded messages.
+ * The digests of the results are printed, so that the output of a library built with
+ * -DJAB_GENERIC_KERNELS can be compared with the vector kernels, see "make compare".
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "jabcode.h"
+#include "detector.h"
+#include "ldpc.h"
+#include "pseudo_random.h"
+
+#define COMPARE_SEED	7151
+
+typedef enum
+{
+	COMPARE_BLOCK_BINARIZER = 0,
+	COMPARE_INTEGRAL_BINARIZER,
+	COMPARE_DECODE,
+	COMPARE_DECODE_OPTIONS,
+	COMPARE_LDPC
+}jab_compare_type;
+
+static const jab_char* compare_names[] = {"block", "integral", "decode", "decode-options", "ldpc"};
+
+/**
+ * @brief Add bytes to a FNV-1a digest
+ * @param hash the digest
+ * @param data the bytes
+ * @param length the number of bytes
+ * @return the new digest
+*/
+static jab_uint64 hashBytes(jab_uint64 hash, const void* data, jab_int32 length)
+{
+	for(jab_int32 i=0; i<length; i++)
+	{
+		hash ^= ((const jab_byte*)data)[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/**
+ * @brief Get the digest of bit-packed binary planes, the row padding is left out
+ * @param ch the planes
+ * @return the digest
+*/
+static jab_uint64 hashPlanes(jab_bitmap* ch[3])
+{
+	jab_uint64 hash = 14695981039346656037ULL;
+	for(jab_int32 c=0; c<3; c++)
+	{
+		hash = hashBytes(hash, &ch[c]->width, sizeof(jab_int32));
+		hash = hashBytes(hash, &ch[c]->height, sizeof(jab_int32));
+		for(jab_int32 y=0; y<ch[c]->height; y++)
+		{
+			const jab_byte* row = getBinaryRow(ch[c], y);
+			hash = hashBytes(hash, row, ch[c]->width / 8);
+			if(ch[c]->width % 8)
+			{
+				jab_byte last = row[ch[c]->width / 8] & ((1 << (ch[c]->width % 8)) - 1);
+				hash = hashBytes(hash, &last, 1);
+			}
+		}
+	}
+	return hash;
+}
+
+/**
+ * @brief Binarize a bitmap
+ * @param bitmap the bitmap
+ * @param integral 1: integral binarizer | 0: block binarizer
+ * @return the digest of the binary planes, 0 if failed
+*/
+static jab_uint64 runBinarizer(jab_bitmap* bitmap, jab_boolean integral)
+{
+	jab_bitmap* ch[3];
+	jab_int32 binarized = integral ? binarizerIntegral(bitmap, ch, 0, 0) : binarizerRGB(bitmap, ch, 0);
+	if(!binarized)
+		return 0;
+	jab_uint64 hash = hashPlanes(ch);
+	for(jab_int32 c=0; c<3; free(ch[c++]));
+	return hash;
+}
+
+/**
+ * @brief Decode a bitmap
+ * @param bitmap the bitmap
+ * @param options the decode options | NULL for the defaults
+ * @return the digest of the decoded data, 0 if failed
+*/
+static jab_uint64 runDecoder(jab_bitmap* bitmap, jab_decode_options* options)
+{
+	jab_data* data = decodeJABCodeEx(bitmap, NORMAL_DECODE, options);
+	if(data == NULL)
+		return 0;
+	jab_uint64 hash = hashBytes(14695981039346656037ULL, &data->length, sizeof(jab_int32));
+	hash = hashBytes(hash, data->data, data->length);
+	free(data);
+	return hash;
+}
+
+/**
+ * @brief Encode a random message, flip bits and decode it with the hard decision decoder
+ * @param wc the number of '1's in a column
+ * @param wr the number of '1's in a row
+ * @param length the message length in bits
+ * @return the digest of the encoded and decoded message
+*/
+static jab_uint64 runLDPC(jab_int32 wc, jab_int32 wr, jab_int32 length)
+{
+	jab_lcg64 random;
+	setSeed(&random, COMPARE_SEED + length);
+	//encodeLDPC may read up to one sub-block beyond the message, the padding is zero
+	jab_data* data = (jab_data*)calloc(1, sizeof(jab_data) + 2 * length * sizeof(jab_char));
+	if(data == NULL)
+		return 0;
+	data->length = length;
+	for(jab_int32 i=0; i<length; i++)
+		data->data[i] = lcg64_temper(&random) & 1;
+	jab_int32 coderate_params[2] = {wc, wr};
+	jab_int32 from_to[2] = {0, length};
+	jab_data* encoded = encodeLDPC(data, coderate_params, from_to, 0);
+	free(data);
+	if(encoded == NULL)
+		return 0;
+	jab_uint64 hash = hashBytes(14695981039346656037ULL, encoded->data, encoded->length);
+	//about one error in 60 bits, close to the limit of the bit flipping decoder
+	for(jab_int32 i=0; i<encoded->length / 60; i++)
+		encoded->data[lcg64_temper(&random) % encoded->length] ^= 1;
+	jab_int32 decoded = decodeLDPChd((jab_byte*)encoded->data, encoded->length, wc, wr, 0);
+	hash = hashBytes(hash, &decoded, sizeof(jab_int32));
+	hash = hashBytes(hash, encoded->data, encoded->length);
+	free(encoded);
+	return hash;
+}
+
+/**
+ * @brief Create the bitmap of a single symbol code
+ * @param color_number the number of module colors
+ * @param length the message length
+ * @param module_size the module size in pixels
+ * @return the bitmap | NULL if failed
+*/
+static jab_bitmap* createCodeBitmap(jab_int32 color_number, jab_int32 length, jab_int32 module_size)
+{
+	jab_data* data = (jab_data*)malloc(sizeof(jab_data) + length * sizeof(jab_char));
+	jab_encode* enc = createEncode(color_number, 1);
+	if(data == NULL || enc == NULL)
+	{
+		free(data);
+		if(enc) destroyEncode(enc);
+		return NULL;
+	}
+	data->length = length;
+	for(jab_int32 i=0; i<length; i++)
+		data->data[i] = "JAB Code compare 0123456789 abcdefghijklmnopqrstuvwxyz"[(i * 7 + color_number) % 55];
+	enc->module_size = module_size;
+	jab_bitmap* bitmap = NULL;
+	if(generateJABCode(enc, data))
+	{
+		jab_int32 size = sizeof(jab_bitmap) + enc->bitmap->width * enc->bitmap->height * (enc->bitmap->bits_per_pixel / 8);
+		bitmap = (jab_bitmap*)malloc(size);
+		if(bitmap)
+			memcpy(bitmap, enc->bitmap, size);
+	}
+	destroyEncode(enc);
+	free(data);
+	return bitmap;
+}
+
+/**
+ * @brief Scale, rotate and add noise to a bitmap, as a camera would
+ * @param src the source bitmap with 4 bytes per pixel
+ * @param scale the scale factor
+ * @param angle the rotation angle in radians
+ * @param noise the maximal noise added to each channel
+ * @param bytes_per_pixel the bytes per pixel of the result, 3 or 4
+ * @return the distorted bitmap | NULL if failed
+*/
+static jab_bitmap* distortBitmap(jab_bitmap* src, jab_float scale, jab_float angle, jab_int32 noise, jab_int32 bytes_per_pixel)
+{
+	//a white border of 20% on each side
+	jab_int32 width = (jab_int32)(src->width * scale * 1.4f);
+	jab_int32 height= (jab_int32)(src->height* scale * 1.4f);
+	jab_bitmap* dst = (jab_bitmap*)malloc(sizeof(jab_bitmap) + width * height * bytes_per_pixel);
+	if(dst == NULL)
+		return NULL;
+	dst->width = width;
+	dst->height = height;
+	dst->bits_per_channel = 8;
+	dst->bits_per_pixel = bytes_per_pixel * 8;
+	dst->channel_count = bytes_per_pixel;
+	jab_lcg64 random;
+	setSeed(&random, COMPARE_SEED + width);
+	jab_float c = cosf(angle), s = sinf(angle);
+	for(jab_int32 y=0; y<height; y++)
+	{
+		for(jab_int32 x=0; x<width; x++)
+		{
+			jab_float dx = (x - width / 2.0f) / scale, dy = (y - height / 2.0f) / scale;
+			jab_int32 sx = (jab_int32)floorf(c * dx + s * dy + src->width / 2.0f);
+			jab_int32 sy = (jab_int32)floorf(-s * dx + c * dy + src->height / 2.0f);
+			jab_byte* pixel = &dst->pixel[(y * width + x) * bytes_per_pixel];
+			for(jab_int32 k=0; k<bytes_per_pixel; k++)
+			{
+				jab_int32 value = 255;
+				if(sx >= 0 && sx < src->width && sy >= 0 && sy < src->height)
+					value = src->pixel[(sy * src->width + sx) * 4 + k];
+				if(noise > 0 && k < 3)
+					value += (jab_int32)(lcg64_temper(&random) % (2 * noise + 1)) - noise;
+				pixel[k] = (jab_byte)(value < 0 ? 0 : (value > 255 ? 255 : value));
+			}
+		}
+	}
+	return dst;
+}
+
+/**
+ * @brief Create a bitmap of random pixels
+ * @param width the bitmap width
+ * @param height the bitmap height
+ * @return the bitmap | NULL if failed
+*/
+static jab_bitmap* createNoiseBitmap(jab_int32 width, jab_int32 height)
+{
+	jab_bitmap* bitmap = (jab_bitmap*)malloc(sizeof(jab_bitmap) + width * height * 4);
+	if(bitmap == NULL)
+		return NULL;
+	bitmap->width = width;
+	bitmap->height = height;
+	bitmap->bits_per_channel = 8;
+	bitmap->bits_per_pixel = 32;
+	bitmap->channel_count = 4;
+	jab_lcg64 random;
+	setSeed(&random, COMPARE_SEED);
+	for(jab_int32 i=0; i<width * height * 4; i++)
+		bitmap->pixel[i] = (jab_byte)lcg64_temper(&random);
+	return bitmap;
+}
+
+/**
+ * @brief Run a case once
+ * @param type the case type
+ * @param bitmap the bitmap of image cases
+ * @param code the wc, wr and message length of LDPC cases
+ * @return the digest of the result
+*/
+static jab_uint64 runCase(jab_compare_type type, jab_bitmap* bitmap, const jab_int32 code[3])
+{
+	jab_decode_options options = {BINARIZER_INTEGRAL, 0, 1, DETECT_POLICY_CASCADE, 0};
+	switch(type)
+	{
+	case COMPARE_BLOCK_BINARIZER:
+		return runBinarizer(bitmap, 0);
+	case COMPARE_INTEGRAL_BINARIZER:
+		return runBinarizer(bitmap, 1);
+	case COMPARE_DECODE:
+		return runDecoder(bitmap, NULL);
+	case COMPARE_DECODE_OPTIONS:
+		return runDecoder(bitmap, &options);
+	default:
+		return runLDPC(code[0], code[1], code[2]);
+	}
+}
+
+/**
+ * @brief Run a case with one thread and with several threads, and print the digest
+ * @param type the case type
+ * @param name the case name
+ * @param bitmap the bitmap of image cases
+ * @param code the wc, wr and message length of LDPC cases
+ * @param threads the number of threads of the second run
+ * @return 0: identical | 1: different
+*/
+static jab_int32 compareCase(jab_compare_type type, const jab_char* name, jab_bitmap* bitmap, const jab_int32 code[3], jab_int32 threads)
+{
+	setThreadNumber(1);
+	jab_uint64 single = runCase(type, bitmap, code);
+	setThreadNumber(threads);
+	jab_uint64 parallel = runCase(type, bitmap, code);
+	printf("%-16s %-24s %016llx%s\n", compare_names[type], name, (unsigned long long)single, single == parallel ? "" : " THREAD MISMATCH");
+	if(single != parallel)
+		fprintf(stderr, "jab_compare: %s %s differs with %d threads\n", compare_names[type], name, threads);
+	return single != parallel;
+}
+
+int main(int argc, char *argv[])
+{
+	jab_int32 threads = 4;
+	if(argc > 1)
+		threads = atoi(argv[1]);
+
+	jab_int32 colors[] = {4, 8, 16, 64, 256};
+	jab_int32 lengths[] = {40, 900};
+	jab_int32 failed = 0;
+	for(jab_int32 i=0; i<(jab_int32)(sizeof(colors)/sizeof(colors[0])); i++)
+	{
+		for(jab_int32 j=0; j<(jab_int32)(sizeof(lengths)/sizeof(lengths[0])); j++)
+		{
+			jab_bitmap* code = createCodeBitmap(colors[i], lengths[j], 6);
+			if(code == NULL)
+			{
+				reportError("Creating the code failed");
+				return 1;
+			}
+			jab_bitmap* bitmaps[3] = {code, distortBitmap(code, 1.37f, 0.05f, 30, 4), distortBitmap(code, 2.1f, 0.0f, 60, 3)};
+			const jab_char* variants[3] = {"clean", "distorted", "distorted-rgb"};
+			for(jab_int32 v=0; v<3; v++)
+			{
+				if(bitmaps[v] == NULL)
+				{
+					reportError("Memory allocation for distorted bitmap failed");
+					return 1;
+				}
+				jab_char name[64];
+				snprintf(name, sizeof(name), "c%d-l%d-%s", colors[i], lengths[j], variants[v]);
+				failed += compareCase(COMPARE_BLOCK_BINARIZER, name, bitmaps[v], NULL, threads);
+				failed += compareCase(COMPARE_INTEGRAL_BINARIZER, name, bitmaps[v], NULL, threads);
+				//the decoder reads 4 bytes per pixel
+				if(bitmaps[v]->bits_per_pixel == 32)
+				{
+					failed += compareCase(COMPARE_DECODE, name, bitmaps[v], NULL, threads);
+					failed += compareCase(COMPARE_DECODE_OPTIONS, name, bitmaps[v], NULL, threads);
+				}
+				free(bitmaps[v]);
+			}
+		}
+	}
+
+	jab_bitmap* noise = createNoiseBitmap(1931, 1277);
+	if(noise == NULL)
+	{
+		reportError("Memory allocation for noise bitmap failed");
+		return 1;
+	}
+	failed += compareCase(COMPARE_BLOCK_BINARIZER, "noise-1931x1277", noise, NULL, threads);
+	failed += compareCase(COMPARE_INTEGRAL_BINARIZER, "noise-1931x1277", noise, NULL, threads);
+	failed += compareCase(COMPARE_DECODE, "noise-1931x1277", noise, NULL, threads);
+	free(noise);
+
+	//(wc, wr, message length), the long messages are split into several sub-blocks
+	jab_int32 codes[][3] = {{3, 4, 120}, {4, 7, 1500}, {4, 9, 3000}, {5, 6, 900}, {6, 8, 5000}, {3, 8, 2000}};
+	for(jab_int32 i=0; i<(jab_int32)(sizeof(codes)/sizeof(codes[0])); i++)
+	{
+		jab_char name[64];
+		snprintf(name, sizeof(name), "wc%d-wr%d-l%d", codes[i][0], codes[i][1], codes[i][2]);
+		failed += compareCase(COMPARE_LDPC, name, NULL, codes[i], threads);
+	}
+
+	if(failed)
+		fprintf(stderr, "jab_compare: %d cases differ between 1 and %d threads\n", failed, threads);
+	return failed > 0;
+}
@@ -0,0 +1,162 @@
+/**
+ * libjabcode - JABCode Encoding/Decoding Library
+ *
+ * Copyright 2016 by Fraunhofer SIT. All rights reserved.
+ * See LICENSE file for full terms of use and distribution.
+ *
+ * Contact: Huajian Liu <liu@sit.fraunhofer.de>
+ *			Waldemar Berchtold <waldemar.berchtold@sit.fraunhofer.de>
+ *
+ * @file ldpc_bench.c
+ * @brief Benchmark of the belief propagation LDPC decoders with and without the phi approximation
+ *
+ * Usage: ldpc_bench [wc wr capacity [sigma [runs]]]
+ * The BP and ILL decoders run on one sub-block of the given code (default wc=4, wr=7, capacity=2016),
+ * once with tanh/atanh and once with the table based phi approximation (setLDPCPhiApproximation).
+ * The time per iteration is measured on random reliabilities, which never converge, so every run takes
+ * all iterations. The corrected count is measured on the all-zero codeword with Gaussian noise of the
+ * given standard deviation (default 0.75) on the +1 signal.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "jabcode.h"
+#include "ldpc.h"
+
+#define BENCH_MAX_ITER	25		//the iteration limit of decodeLDPC
+
+typedef jab_int32 (*jab_soft_decoder)(jab_float* enc, jab_tanner_graph* graph, jab_int32 length, jab_int32 checkbits, jab_int32 max_iter, jab_boolean *is_correct, jab_int32 start_pos, jab_byte* dec, jab_ldpc_scratch* scratch);
+
+static const struct {
+	const jab_char*		name;
+	jab_soft_decoder	decode;
+}decoders[] = {
+	{"BP",	decodeMessageBP},
+	{"ILL",	decodeMessageILL}
+};
+
+/**
+ * @brief Get the current time
+ * @return the time in microseconds
+*/
+static jab_double getTime(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/**
+ * @brief Draw a normally distributed number with the Box-Muller transform
+ * @return the number
+*/
+static jab_double getGaussian(void)
+{
+	jab_double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+	jab_double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+	return sqrt(-2.0 * log(u1)) * cos(2.0 * 3.14159265358979 * u2);
+}
+
+/**
+ * @brief Fill the decoder input with the received +1 signal of the all-zero codeword
+ * @param enc the reliability of each bit
+ * @param dec the hard decision of each bit
+ * @param length the number of bits
+ * @param sigma the standard deviation of the noise, negative for random values without a codeword
+*/
+static void createInput(jab_float* enc, jab_byte* dec, jab_int32 length, jab_double sigma)
+{
+	for(jab_int32 i=0; i<length; i++)
+	{
+		jab_double y = sigma < 0 ? 2.0 * rand() / RAND_MAX - 1.0 : 1.0 + sigma * getGaussian();
+		enc[i] = (jab_float)fabs(y);
+		dec[i] = y < 0;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	jab_int32 wc = 4, wr = 7, capacity = 2016;
+	jab_double sigma = 0.75;
+	jab_int32 runs = 20;
+	if(argc > 3)
+	{
+		wc = atoi(argv[1]);
+		wr = atoi(argv[2]);
+		capacity = atoi(argv[3]);
+	}
+	if(argc > 4)
+		sigma = atof(argv[4]);
+	if(argc > 5)
+		runs = atoi(argv[5]);
+
+	jab_ldpc_matrix* ldpc = getLDPCMatrix(wc, wr, capacity, 0);
+	if(ldpc == NULL)
+	{
+		reportError("LDPC matrix could not be created");
+		return 1;
+	}
+	jab_float* input = (jab_float*)malloc(2 * capacity * sizeof(jab_float));
+	jab_byte* hard = (jab_byte*)malloc(2 * capacity * sizeof(jab_byte));
+	if(input == NULL || hard == NULL)
+	{
+		reportError("Memory allocation for decoder input failed");
+		return 1;
+	}
+	jab_float* enc = input + capacity;
+	jab_byte* dec = hard + capacity;
+	jab_ldpc_scratch scratch = {NULL, 0};
+
+	printf("code wc=%d wr=%d capacity=%d rank=%d edges=%d, noise sigma=%.2f, %d runs\n",
+		   wc, wr, capacity, ldpc->matrix_rank, ldpc->graph->edge_number, sigma, runs);
+	printf("decoder  phi   us/iteration  corrected\n");
+	for(jab_int32 d=0; d<(jab_int32)(sizeof(decoders)/sizeof(decoders[0])); d++)
+	{
+		for(jab_int32 phi=0; phi<2; phi++)
+		{
+			setLDPCPhiApproximation(phi);
+			//the same inputs for every decoder and phi setting
+			srand(1);
+			jab_double elapsed = 0;
+			jab_int32 iterations = 0;
+			for(jab_int32 r=0; r<runs; r++)
+			{
+				createInput(input, hard, capacity, -1);
+				memcpy(enc, input, capacity * sizeof(jab_float));
+				memcpy(dec, hard, capacity * sizeof(jab_byte));
+				jab_boolean is_correct = 0;
+				jab_double start = getTime();
+				if(!decoders[d].decode(enc, ldpc->graph, capacity, ldpc->matrix_rank, BENCH_MAX_ITER, &is_correct, 0, dec, &scratch))
+					return 1;
+				//a converged run stops early, it is not counted
+				if(!is_correct)
+				{
+					elapsed += getTime() - start;
+					iterations += BENCH_MAX_ITER;
+				}
+			}
+			jab_int32 corrected = 0;
+			for(jab_int32 r=0; r<runs; r++)
+			{
+				createInput(enc, dec, capacity, sigma);
+				jab_boolean is_correct = 0;
+				if(!decoders[d].decode(enc, ldpc->graph, capacity, ldpc->matrix_rank, BENCH_MAX_ITER, &is_correct, 0, dec, &scratch))
+					return 1;
+				jab_int32 errors = 0;
+				for(jab_int32 i=0; i<capacity; i++)
+					errors += dec[i];
+				corrected += is_correct && errors == 0;
+			}
+			printf("%-8s %-5s %12.1f  %d/%d\n", decoders[d].name, phi ? "on" : "off",
+				   iterations > 0 ? elapsed / iterations : 0.0, corrected, runs);
+		}
+	}
+	free(scratch.buffer);
+	free(input);
+	free(hard);
+	releaseLDPCMatrix(ldpc);
+	return 0;
+}
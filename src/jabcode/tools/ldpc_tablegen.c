@@ -0,0 +1,156 @@
+/**
+ * libjabcode - JABCode Encoding/Decoding Library
+ *
+ * Copyright 2016 by Fraunhofer SIT. All rights reserved.
+ * See LICENSE file for full terms of use and distribution.
+ *
+ * Contact: Huajian Liu <liu@sit.fraunhofer.de>
+ *			Waldemar Berchtold <waldemar.berchtold@sit.fraunhofer.de>
+ *
+ * @file ldpc_tablegen.c
+ * @brief Build time generator of the precomputed LDPC matrix tables
+ *
+ * Usage: ldpc_tablegen <max_capacity> > ldpc_tables.c
+ * The generated tables contain the matrices of all metadata codes and of all
+ * message codes with a (sub-block) capacity not larger than max_capacity.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "jabcode.h"
+#include "ldpc.h"
+#include "detector.h"
+#include "decoder.h"
+
+#define MAX_SUB_BLOCK_CAPACITY	2700	//sub-block size limit used in encodeLDPC and decodeLDPC
+
+typedef struct {
+	jab_int32	wc;
+	jab_int32	wr;
+	jab_int32	capacity;
+	jab_int32	matrix_rank[2];			///< the ranks of the decoder and encoder matrices
+}jab_table_entry;
+
+static jab_table_entry* entries = 0;
+static jab_int32 entry_number = 0;
+
+/**
+ * @brief Report error message
+ * @param message the error message
+*/
+void reportError(jab_char* message)
+{
+	fprintf(stderr, "ldpc_tablegen: %s\n", message);
+}
+
+/**
+ * @brief Print an integer array
+ * @param index the table index used in the array name
+ * @param data the array
+ * @param length the array length
+*/
+void printArray(jab_int32 index, jab_int32* data, jab_int32 length)
+{
+	printf("static const jab_int32 ldpc_data_%d[%d] = {", index, length);
+	for(jab_int32 i=0; i<length; i++)
+	{
+		if(i % 8 == 0) printf("\n\t");
+		printf("%d,", data[i]);
+	}
+	printf("\n};\n");
+}
+
+/**
+ * @brief Generate and print the decoder and encoder matrices for one set of code parameters
+ * @param wc the number of '1's in a column
+ * @param wr the number of '1's in a row, 0 for metadata
+ * @param capacity the number of columns of the matrix
+ * @return 0: success | 1: failed
+*/
+jab_int32 generateEntry(jab_int32 wc, jab_int32 wr, jab_int32 capacity)
+{
+	jab_table_entry* entry = &entries[entry_number];
+	entry->wc = wc;
+	entry->wr = wr;
+	entry->capacity = capacity;
+	for(jab_int32 encode=0; encode<2; encode++)
+	{
+		jab_ldpc_matrix* ldpc = createLDPCMatrix(wc, wr, capacity, encode);
+		if(ldpc == NULL)
+			return 1;
+		entry->matrix_rank[encode] = ldpc->matrix_rank;
+		if(encode)
+		{
+			//gap, edge_number, row_start, row_column, pivot_column and the gap inverse, see ldpc.h
+			jab_int32 gap = ldpc->encoder[0];
+			printArray(2*entry_number+1, ldpc->encoder, 2 + ldpc->matrix_rank+1 + ldpc->encoder[1] + ldpc->matrix_rank + gap*((gap+31)/32));
+		}
+		else
+			printArray(2*entry_number, ldpc->matrix, (jab_int32)ceil(capacity / (jab_float)32) * ldpc->height);
+		freeLDPCMatrix(ldpc);
+	}
+	entry_number++;
+	return 0;
+}
+
+/**
+ * @brief Generate the matrices of all tabulated code parameters, sorted by (wc, wr, capacity)
+ * @param max_capacity the maximal capacity of message codes
+ * @return 0: success | 1: failed
+*/
+jab_int32 generateTables(jab_int32 max_capacity)
+{
+	if(max_capacity > MAX_SUB_BLOCK_CAPACITY)
+		max_capacity = MAX_SUB_BLOCK_CAPACITY;
+	entries = (jab_table_entry*)malloc((2*MASTER_METADATA_PART3_MAX_LENGTH + 6*6*(max_capacity/4+1)) * sizeof(jab_table_entry));
+	if(entries == NULL)
+	{
+		reportError("Memory allocation for table entries failed");
+		return 1;
+	}
+	for(jab_int32 wc=2; wc<=8; wc++)
+	{
+		//metadata codes, as used in encodeLDPC and decodeLDPC with wr <= 0
+		for(jab_int32 capacity=MASTER_METADATA_PART1_LENGTH; wc<=3 && capacity<=MASTER_METADATA_PART3_MAX_LENGTH; capacity+=2)
+		{
+			if(generateEntry(wc, 0, capacity)) return 1;
+		}
+		//message codes, with the (wc, wr) range searched by the encoder
+		for(jab_int32 wr=wc+1; wc>=3 && wr<=9; wr++)
+		{
+			for(jab_int32 capacity=wr; capacity<=max_capacity; capacity+=wr)
+			{
+				if(generateEntry(wc, wr, capacity)) return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	jab_int32 max_capacity = 0;
+	if(argc > 1)
+		max_capacity = atoi(argv[1]);
+
+	printf("/* Generated by tools/ldpc_tablegen.c with max capacity %d, do not edit. */\n\n", max_capacity);
+	printf("#include \"jabcode.h\"\n#include \"ldpc.h\"\n\n");
+	if(generateTables(max_capacity))
+	{
+		reportError("Generating LDPC matrix tables failed");
+		return 1;
+	}
+	printf("\n//sorted by (wc, wr, capacity, encode)\n");
+	printf("jab_ldpc_matrix ldpc_tables[] = {\n");
+	for(jab_int32 i=0; i<entry_number; i++)
+	{
+		jab_table_entry* e = &entries[i];
+		jab_int32 height = e->wr<4 ? e->capacity/2 : e->capacity/e->wr*e->wc;
+		printf("\t{%d, %d, %d, 0, %d, %d, (jab_int32*)ldpc_data_%d, 0, 0, 0, 0, 1},\n", e->wc, e->wr, e->capacity, height, e->matrix_rank[0], 2*i);
+		printf("\t{%d, %d, %d, 1, %d, %d, 0, (jab_int32*)ldpc_data_%d, 0, 0, 0, 1},\n", e->wc, e->wr, e->capacity, height, e->matrix_rank[1], 2*i+1);
+	}
+	printf("};\n\nconst jab_int32 ldpc_table_number = %d;\n", 2*entry_number);
+	free(entries);
+	return 0;
+}